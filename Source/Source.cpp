@@ -1,95 +1,990 @@
 #include "VapourSynth4.h"
 #include "VSHelper4.h"
+#include "dpid.h"
+#include "dpid_cache.h"
+#include "dpid_pool.h"
+#include "dpid_stats.h"
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cmath>
+#include <chrono>
 #include <string>
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 
-struct DpidData {
-    VSNode *node1, *node2;
+// one output size
+struct DpidLevel {
     int dst_w, dst_h;
+    int reduce; // factor of the pre-reduction of hierarchical=True, 1 otherwise
+    bool rgb_guide; // shared_weights on RGB: the planes are filtered in the same bands
+    std::vector<DpidGeometry> geometry[3]; // indexed by _ChromaLocation for chroma planes
+    std::vector<std::shared_ptr<DpidCounters>> counters[3]; // same indices, empty unless "stats"
+};
+
+// work of one plane in a frame
+struct DpidPlane {
+    const void *src1p;
+    int src1_stride;
+    const void *src2p;
+    int src2_stride;
+    void *dstp[DPID_SWEEP_MAX]; // one per output of DpidSweep, only [0] otherwise
+    int dst_stride;
+    float *downp, *avgp;
+    int avg_stride;
+    const DpidGeometry *geometry;
+    float lambda;
+    const DpidLut *lut;
+    DpidResize resize;
+    DpidBlur blur;
+    DpidKernel kernel;
+    DpidSweepKernel sweep; // nullptr unless DpidSweep
+    DpidCounters *counters; // nullptr unless "stats"
+
+    // hierarchical=True: the guide and the kernel read the source reduced by
+    // `reduce` instead of src1p, and the kernel writes float to `filteredp`
+    DpidReduce reduce; // nullptr for the exact path
+    int factor;
+    int src1_w, src1_h;
+    float *reducedp;
+    int reduced_stride;
+    float *filteredp;  // avg_stride like the guide
+    DpidStore store;
+
+    // The planes whose passes run in the bands of this one, itself first.
+    // With DpidLevel::rgb_guide, the bands of the first plane run the passes
+    // of all of them, so that its weight map can be computed from the guide
+    // of every plane, and the others are `joined` and have no bands.
+    const DpidPlane *band_planes[DPID_GUIDE_MAX];
+    int num_band_planes;
+    bool joined;
+
+    // shared_weights: the kernel reads the weight map at `weightp`, which the
+    // first plane computes with `weights` from the guide of the planes with a
+    // guide_weight, and the first plane of every smaller size shrinks from the
+    // map of `shrink_from`. The other planes read the map of their size.
+    DpidSharedKernel shared; // nullptr unless shared_weights
+    DpidWeights weights;     // nullptr except for the first plane
+    float guide_weight;
+    float *weightp;
+    int weight_stride;
+    const DpidPlane *shrink_from;
+};
+
+struct DpidBand {
+    const DpidPlane *plane;
+    int y_begin, y_end;
+};
+
+// Temporary data of filterFrame, kept for the next frame so that the vectors
+// do not have to grow again.
+struct DpidFrameScratch {
+    std::vector<VSFrame *> dst;
+    std::vector<DpidPlane> planes;
+    std::vector<float> avg, down;
+    std::vector<float> reduced, filtered; // hierarchical=True
+    std::vector<float> weights;           // shared_weights
+    std::vector<DpidBand> bands;
+    std::vector<size_t> tasks;
+};
+
+// Scratch objects of one filter, each used by a single thread at a time. A
+// thread takes a free one or creates it, and puts it back when it is done, so
+// there are as many as threads ever worked on the filter at once. They are
+// freed with the filter.
+template<typename T>
+class DpidScratchPool {
+public:
+    class Lease {
+    public:
+        explicit Lease(DpidScratchPool &pool) : pool(pool) {
+            {
+                std::lock_guard<std::mutex> lock(pool.mutex);
+                if (!pool.free.empty()) {
+                    object = std::move(pool.free.back());
+                    pool.free.pop_back();
+                }
+            }
+
+            if (!object)
+                object = std::make_unique<T>();
+        }
+
+        ~Lease() {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.free.push_back(std::move(object));
+        }
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        T &operator*() const noexcept { return *object; }
+        T *operator->() const noexcept { return object.get(); }
+
+    private:
+        DpidScratchPool &pool;
+        std::unique_ptr<T> object;
+    };
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<T>> free;
+};
+
+struct DpidData {
+    VSNode *node1, *node2; // node2 is nullptr when the guide is computed internally
+    std::vector<DpidLevel> levels; // more than one only for DpidMulti
+    std::vector<float> sweep;      // lambda values of DpidSweep, one output each
+    int band_level;                // level whose rows define the bands, the tallest one
     float lambda[3];
     float src_left[3], src_top[3];
     float src_width[3], src_height[3];
     bool process[3];
     bool read_chromaloc;
+    bool hierarchical;
+    bool shared_weights;
+    int shared_class;      // DPID_LAMBDA_* of the weight map of shared_weights
+    float guide_weight[3]; // share of every plane in the guide of the weight map
+    int opt;
+    bool stats;
+    DpidLut lut[3];                        // empty unless "lut" applies to the plane
+    int lambda_class[3];                   // DPID_LAMBDA_*, with "lut" and "fast" applied
+    std::unique_ptr<DpidThreadPool> pool; // nullptr with threads=1
+    int band_rows;                        // output rows of the band level per task
+    std::atomic<int> frames_in_flight;
+    std::unique_ptr<DpidFrameCache> cache; // nullptr unless "cache"
+    DpidScratchPool<DpidFrameScratch> frame_scratch; // one per frame in flight
+    DpidScratchPool<DpidScratch> pass_scratch;       // one per running task
 };
 
+// data of the nodes returned by DpidMulti and DpidSweep
+struct DpidLevelData {
+    VSNode *node; // the node computing all outputs
+    int level;    // output
+    int num_levels;
+};
 
-static float contribution(float f, float x, float y, 
-    float sx, float ex, float sy, float ey) {
 
-    if (x < sx)
-        f *= 1.0f - (sx - x);
+// Frame property of the DpidMulti and DpidSweep nodes holding output `level`;
+// output 0 is the frame itself.
+static std::string levelKey(int level) {
+    return "DpidLevel" + std::to_string(level);
+}
 
-    if ((x + 1.0f) > ex)
-        f *= ex - x;
+// output frames per request: one per level, or one per lambda value of DpidSweep
+static int numOutputs(const DpidData *d) noexcept {
+    return static_cast<int>(d->sweep.empty() ? d->levels.size() : d->sweep.size());
+}
 
-    if (y < sy)
-        f *= 1.0f - (sy - y);
+static const DpidLevel &outputLevel(const DpidData *d, int output) noexcept {
+    return d->levels[d->sweep.empty() ? output : 0];
+}
 
-    if ((y + 1.0f) > ey)
-        f *= ey - y;
+// Output size of one level. A size of 0 keeps the aspect ratio.
+static DpidLevel makeLevel(int dst_w, int dst_h, const VSVideoInfo *vi) {
+    if (dst_w == 0 && dst_h == 0)
+        throw std::string{"\"width\" and \"height\" can not be equal to 0 at the same time"};
+    else if (dst_w == 0)
+        dst_w = vi->width * dst_h / vi->height;
+    else if (dst_h == 0)
+        dst_h = vi->height * dst_w / vi->width;
+
+    if (dst_w <= 0 || dst_h <= 0)
+        throw std::string{"dimensions of output must be positive"};
+
+    if (dst_w == vi->width && dst_h == vi->height)
+        throw std::string{"dimensions of output is identical to input. "
+            "Please consider remove the function call"};
+
+    DpidLevel level;
+    level.dst_w = dst_w;
+    level.dst_h = dst_h;
+    level.reduce = 1;
+    level.rgb_guide = false;
+    return level;
+}
 
-    return f;
+// footprint tables of one plane of a level
+static void buildPlaneGeometry(DpidData *d, DpidLevel &level, int plane, const VSVideoFormat &fi,
+    int width, int height, bool guide) {
+
+    const int src_w = plane == 0 ? width : (width >> fi.subSamplingW);
+    const int src_h = plane == 0 ? height : (height >> fi.subSamplingH);
+    const int dst_w = plane == 0 ? level.dst_w : (level.dst_w >> fi.subSamplingW);
+    const int dst_h = plane == 0 ? level.dst_h : (level.dst_h >> fi.subSamplingH);
+
+    const float hSubS = plane == 0 ? 1.0f : static_cast<float>(1 << fi.subSamplingW);
+    const float vSubS = plane == 0 ? 1.0f : static_cast<float>(1 << fi.subSamplingH);
+
+    float src_width = d->src_width[plane] / hSubS;
+    if (src_width == 0.0f)
+        src_width = static_cast<float>(src_w);
+    float src_height = d->src_height[plane] / vSubS;
+    if (src_height == 0.0f)
+        src_height = static_cast<float>(src_h);
+
+    // the reduced source in its own pixels
+    const int k = level.reduce;
+    const int reduced_w = dpidReducedSize(src_w, k);
+    const int reduced_h = dpidReducedSize(src_h, k);
+
+    if (plane != 0 && d->read_chromaloc) {
+        for (int chromaLocation = 0; chromaLocation < 6; ++chromaLocation) {
+            const float hCPlace = (chromaLocation == 0 || chromaLocation == 2 || chromaLocation == 4) 
+                ? (0.5f - hSubS / 2) : 0.f;
+            const float hScale = static_cast<float>(dst_w) / src_width;
+
+            const float vCPlace = (chromaLocation == 2 || chromaLocation == 3) 
+                ? (0.5f - vSubS / 2) : ((chromaLocation == 4 || chromaLocation == 5) ? (vSubS / 2 - 0.5f) : 0.f);
+            const float vScale = static_cast<float>(dst_h) / src_height;
+
+            const float src_left = ((d->src_left[plane] - hCPlace) * hScale + hCPlace) / hScale / hSubS;
+            const float src_top = ((d->src_top[plane] - vCPlace) * vScale + vCPlace) / vScale / vSubS;
+
+            level.geometry[plane].push_back(dpidMakeGeometry(
+                reduced_w, reduced_h, dst_w, dst_h, src_left / k, src_top / k, src_width / k, src_height / k, guide));
+        }
+    } else {
+        level.geometry[plane].push_back(dpidMakeGeometry(
+            reduced_w, reduced_h, dst_w, dst_h, d->src_left[plane] / k, d->src_top[plane] / k, src_width / k, src_height / k, guide));
+    }
 }
 
-template<typename T>
-static void dpidProcess(const T * VS_RESTRICT srcp, int src_stride, 
-    const T * VS_RESTRICT downp, int down_stride, 
-    T * VS_RESTRICT dstp, int dst_stride, 
-    int src_w, int src_h, int dst_w, int dst_h, float lambda, 
-    float src_left, float src_top, float src_width, float src_height) {
+// Builds the footprint tables of every processed plane of every level. With
+// read_chromaloc, chroma planes get one table per _ChromaLocation value so
+// that frames only have to pick one. `guide` adds the bilinear filter of the
+// internal guide.
+//
+// hierarchical=True pre-reduces the source of levels with a factor of 32 or
+// more, see dpidReduceFactor().
+static void buildGeometry(DpidData *d, const VSVideoFormat &fi, int width, int height, bool guide) {
+    d->band_level = 0;
+
+    for (DpidLevel &level : d->levels) {
+        const float window_w = d->src_width[0] != 0.0f ? d->src_width[0] : static_cast<float>(width);
+        const float window_h = d->src_height[0] != 0.0f ? d->src_height[0] : static_cast<float>(height);
+        const float factor = std::min(window_w / level.dst_w, window_h / level.dst_h);
+
+        level.reduce = d->hierarchical ? dpidReduceFactor(factor) : 1;
+    }
+
+    for (int level = 0; level < static_cast<int>(d->levels.size()); ++level) {
+        if (d->levels[level].dst_h > d->levels[d->band_level].dst_h)
+            d->band_level = level;
+    }
+
+    for (DpidLevel &level : d->levels) {
+        for (int plane = 0; plane < fi.numPlanes; ++plane) {
+            if (d->process[plane])
+                buildPlaneGeometry(d, level, plane, fi, width, height, guide);
+        }
+    }
+}
+
+
+// Parses "threads" and starts the pool. It is capped to the core's thread
+// count since the calling thread of every frame takes part as well.
+static void createPool(DpidData *d, const VSMap *in, VSCore *core, const VSAPI *vsapi) {
+    int err;
+
+    int threads = vsh::int64ToIntS(vsapi->mapGetInt(in, "threads", 0, &err));
+    if (err)
+        threads = 1;
+
+    if (threads < 0)
+        throw std::string{"\"threads\" must not be negative"};
+
+    VSCoreInfo info;
+    vsapi->getCoreInfo(core, &info);
+
+    if (threads == 0 || threads > info.numThreads)
+        threads = info.numThreads;
+
+    const int dst_h = d->levels[d->band_level].dst_h;
+
+    if (threads > 1) {
+        d->pool = std::make_unique<DpidThreadPool>(threads);
+        // a few bands per thread so that uneven bands and planes balance out
+        d->band_rows = std::max((dst_h + threads * 4 - 1) / (threads * 4), 16);
+    } else if (d->levels.size() > 1) {
+        // the levels share the source rows of a band while they are in cache
+        d->band_rows = std::min(dst_h, 64);
+    } else {
+        d->band_rows = dst_h;
+    }
+}
+
+// Parses the active window "src_left", "src_top", "src_width", "src_height"
+// and "read_chromaloc".
+static void createWindow(DpidData *d, const VSMap *in, const VSVideoFormat &fi, const VSAPI *vsapi) {
+    int err;
+
+    const int numSrcLeft = vsapi->mapNumElements(in, "src_left");
+    if (numSrcLeft > fi.numPlanes)
+        throw std::string{"more \"src_left\" given than there are planes"};
+
+    const int numSrcTop = vsapi->mapNumElements(in, "src_top");
+    if (numSrcTop > fi.numPlanes)
+        throw std::string{"more \"src_top\" given than there are planes"};
+
+    const int numSrcWidth = vsapi->mapNumElements(in, "src_width");
+    if (numSrcWidth > fi.numPlanes)
+        throw std::string{"more \"src_width\" given than there are planes"};
+
+    const int numSrcHeight = vsapi->mapNumElements(in, "src_height");
+    if (numSrcHeight > fi.numPlanes)
+        throw std::string{"more \"src_height\" given than there are planes"};
+
+    for (int i = 0; i < 3; i++) {
+        if (i < numSrcLeft)
+            d->src_left[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_left", i, nullptr));
+        else if (i == 0)
+            d->src_left[0] = 0.0f;
+        else
+            d->src_left[i] = d->src_left[i-1];
+
+        if (i < numSrcTop)
+            d->src_top[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_top", i, nullptr));
+        else if (i == 0)
+            d->src_top[0] = 0.0f;
+        else
+            d->src_top[i] = d->src_top[i-1];
+
+        if (i < numSrcWidth) {
+            d->src_width[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_width", i, nullptr));
+            if (d->src_width[i] < 0.0f)
+                throw std::string{"active window set by \"src_width\" must be positive"};
+        } else if (i == 0)
+            d->src_width[0] = 0.0f;
+        else
+            d->src_width[i] = d->src_width[i - 1];
+
+        if (i < numSrcHeight) {
+            d->src_height[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_height", i, nullptr));
+            if (d->src_height[i] < 0.0f)
+                throw std::string{"active window set by \"src_height\" must be positive"};
+        } else if (i == 0)
+            d->src_height[0] = 0.0f;
+        else
+            d->src_height[i] = d->src_height[i - 1];
+    }
+
+    d->read_chromaloc = static_cast<bool>(vsapi->mapGetInt(in, "read_chromaloc", 0, &err));
+    if (err) {
+        d->read_chromaloc = true;
+    }
+}
+
+// Parses "opt" and resolves 0 to the instruction set of the CPU.
+static void createOpt(DpidData *d, const VSMap *in, const VSAPI *vsapi) {
+    int err;
+
+    d->opt = vsh::int64ToIntS(vsapi->mapGetInt(in, "opt", 0, &err));
+    if (err)
+        d->opt = DPID_OPT_AUTO;
+
+    if (d->opt < DPID_OPT_AUTO || d->opt > DPID_OPT_AVX512)
+        throw std::string{"\"opt\" must be 0, 1, 2, 3 or 4"};
+
+    if (d->opt > dpidGetCpuLevel())
+        throw std::string{"the instruction set requested by \"opt\" is not supported by this CPU"};
+
+    if (d->opt == DPID_OPT_AUTO)
+        d->opt = dpidGetCpuLevel();
+}
+
+// Parses "lut" and "fast", builds the weight tables of the planes "lut"
+// applies to and picks the range kernel of every plane. DpidSweep only takes
+// "fast", which its kernel applies to the general lambda values.
+static void createRange(DpidData *d, const VSMap *in, const VSVideoFormat &fi, const VSAPI *vsapi) {
+    int err;
+
+    const bool lut = !!vsapi->mapGetInt(in, "lut", 0, &err);
+    const bool fast = !!vsapi->mapGetInt(in, "fast", 0, &err);
+
+    if (!d->sweep.empty()) {
+        for (int plane = 0; plane < fi.numPlanes; ++plane)
+            d->lambda_class[plane] = fast ? DPID_LAMBDA_FAST : DPID_LAMBDA_ANY;
+        return;
+    }
+
+    for (int plane = 0; plane < fi.numPlanes; ++plane) {
+        d->lambda_class[plane] = dpidLambdaClass(d->lambda[plane]);
+
+        if (!d->process[plane] || d->lambda_class[plane] != DPID_LAMBDA_ANY)
+            continue;
+
+        if (lut && dpidMakeLut(d->lut[plane], fi.bitsPerSample, fi.sampleType == stFloat, d->lambda[plane]))
+            d->lambda_class[plane] = d->lut[plane].lambda_class;
+        else if (fast)
+            d->lambda_class[plane] = DPID_LAMBDA_FAST;
+    }
+}
+
+// Whether a plane of a level is filtered by the histogram kernel, which has
+// no DpidSweep, hierarchical=True or shared_weights variant.
+static bool useHistogram(const DpidData *d, const DpidLevel &level, int plane, const DpidGeometry &geometry,
+    const VSVideoFormat &fi) noexcept {
+
+    return d->sweep.empty() && level.reduce == 1 && !d->shared_weights &&
+        dpidUseHistogram(fi.bitsPerSample, fi.sampleType == stFloat, d->lambda_class[plane], geometry);
+}
+
+static bool sameAxis(const DpidAxis &a, const DpidAxis &b) {
+    return a.src_size == b.src_size && a.dst_size == b.dst_size &&
+        a.begin == b.begin && a.end == b.end && a.first == b.first && a.last == b.last;
+}
+
+// Parses "shared_weights", which needs the guide planes of the weight map:
+// the first plane, or all planes of RGB clips, whose guide is their BT.709
+// luminance and needs the same footprints in every plane. It is left off
+// when only one plane is processed, which gains nothing from it.
+static void createShared(DpidData *d, const VSMap *in, const VSVideoFormat &fi, const VSAPI *vsapi) {
+    int err;
+
+    d->shared_weights = !!vsapi->mapGetInt(in, "shared_weights", 0, &err);
+    if (!d->shared_weights)
+        return;
+
+    if (d->hierarchical)
+        throw std::string{"\"shared_weights\" and \"hierarchical\" can not be used together"};
+
+    const int num_planes = static_cast<int>(std::count(d->process, d->process + fi.numPlanes, true));
+    const bool rgb = fi.colorFamily == cfRGB;
+
+    if (rgb && num_planes != fi.numPlanes)
+        throw std::string{"\"shared_weights\" requires all planes of RGB clips to be processed"};
+    if (!d->process[0])
+        throw std::string{"\"shared_weights\" requires the first plane to be processed"};
+
+    if (num_planes < 2) {
+        d->shared_weights = false;
+        return;
+    }
+
+    if (rgb) {
+        for (DpidLevel &level : d->levels) {
+            const DpidGeometry &lead = level.geometry[0][0];
+
+            for (int plane = 1; plane < fi.numPlanes; ++plane)
+                for (const DpidGeometry &geometry : level.geometry[plane])
+                    if (!sameAxis(geometry.x, lead.x) || !sameAxis(geometry.y, lead.y))
+                        throw std::string{"\"shared_weights\" requires the same active window for all planes of RGB clips"};
 
-    const float scale_x = src_width / dst_w;
-    const float scale_y = src_height / dst_h;
+            level.rgb_guide = true;
+        }
+
+        d->guide_weight[0] = 0.2126f;
+        d->guide_weight[1] = 0.7152f;
+        d->guide_weight[2] = 0.0722f;
+
+        // the luminance is not a sample value the table has an entry for
+        d->shared_class = d->lut[0].table.empty() ? d->lambda_class[0] : dpidLambdaClass(d->lambda[0]);
+    } else {
+        d->guide_weight[0] = 1.0f;
+        d->guide_weight[1] = 0.0f;
+        d->guide_weight[2] = 0.0f;
+        d->shared_class = d->lambda_class[0];
+    }
+}
+
+// Parses "stats", which defaults to the environment variable DPID_STATS, and
+// sets up the counters of every plane and kernel variant.
+static void createStats(DpidData *d, const VSMap *in, const VSVideoFormat &fi, const std::string &name, const VSAPI *vsapi) {
+    int err;
+
+    d->stats = !!vsapi->mapGetInt(in, "stats", 0, &err);
+    if (err) {
+        const char *env = std::getenv("DPID_STATS");
+        d->stats = env && std::atoi(env) != 0;
+    }
+
+    if (!d->stats)
+        return;
+
+    static const char *opt_names[] = {"auto", "c", "sse4.1", "avx2", "avx512"};
+    static const char *lambda_names[] = {"box", "sqrt", "linear", "square", "pow", "lut", "lut-lerp", "fast"};
+
+    const std::string sample = (fi.sampleType == stFloat ? "f" : "u") + std::to_string(fi.bitsPerSample);
+
+    std::string sweep;
+    if (!d->sweep.empty())
+        sweep = "sweep" + std::to_string(d->sweep.size()) + (d->lambda_class[0] == DPID_LAMBDA_FAST ? " fast" : "");
+
+    for (DpidLevel &level : d->levels) {
+        for (int plane = 0; plane < fi.numPlanes; ++plane) {
+            for (const DpidGeometry &geometry : level.geometry[plane]) {
+                auto counters = dpidAddCounters();
+                counters->filter = name;
+                counters->plane = plane;
+                counters->width = geometry.x.dst_size;
+                counters->height = geometry.y.dst_size;
+                counters->variant = sample + " " + opt_names[d->opt] + " " +
+                    (!sweep.empty() ? sweep : lambda_names[d->shared_weights ? d->shared_class : d->lambda_class[plane]]) +
+                    (geometry.aligned ? " aligned" : "") +
+                    (level.reduce > 1 ? " reduce" + std::to_string(level.reduce) : "") +
+                    (useHistogram(d, level, plane, geometry, fi) ? " histogram" : "") + (d->shared_weights ? " shared" : "");
+
+                counters->footprint_row = 0;
+                for (int x = 0; x < geometry.x.dst_size; ++x)
+                    counters->footprint_row += geometry.x.end[x] - geometry.x.begin[x];
+
+                level.counters[plane].push_back(std::move(counters));
+            }
+        }
+    }
+}
+
+// Parses "cache", the number of distinct source frames whose output is kept.
+static void createCache(DpidData *d, const VSMap *in, const VSAPI *vsapi) {
+    int err;
+
+    const int64_t cache = vsapi->mapGetInt(in, "cache", 0, &err);
+
+    if (cache < 0)
+        throw std::string{"\"cache\" must not be negative"};
+
+    if (cache > 0)
+        d->cache = std::make_unique<DpidFrameCache>(vsh::int64ToIntS(cache), vsapi);
+}
+
+static int64_t nowNs() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs the tasks on the pool, unless every thread already has a frame to work on.
+static void runTasks(DpidData *d, int count, const std::function<void(int)> &task) {
+    if (d->pool && d->frames_in_flight.load(std::memory_order_relaxed) < d->pool->size()) {
+        d->pool->run(count, task);
+    } else {
+        for (int i = 0; i < count; ++i)
+            task(i);
+    }
+}
+
+// first row of `axis` whose footprint does not start above the one of row `y` of `band_axis`
+static int firstRow(const DpidAxis &axis, const DpidAxis &band_axis, int y) {
+    if (y <= 0)
+        return 0;
+    if (y >= band_axis.dst_size)
+        return axis.dst_size;
+
+    const auto end = axis.begin.begin() + axis.dst_size;
+    return static_cast<int>(std::lower_bound(axis.begin.begin(), end, band_axis.begin[y]) - axis.begin.begin());
+}
+
+// _ChromaLocation of a frame, which selects the geometry of the chroma planes
+static int frameChromaLocation(const DpidData *d, const VSFrame *props, const VSAPI *vsapi) {
+    if (!d->read_chromaloc)
+        return 0;
+
+    int err;
+
+    const int location = vsh::int64ToIntS(vsapi->mapGetInt(vsapi->getFramePropertiesRO(props), "_ChromaLocation", 0, &err));
+    if (err)
+        return 0;
+
+    // undefined values are sited like "center"
+    if (location < 0 || location > 5)
+        return 1;
+
+    return location;
+}
+
+// Filters the processed planes of a frame into s.dst[i] for every level `i`,
+// or for every lambda value `i` of DpidSweep.
+static void filterFrame(DpidData *d, const VSFrame *src1, const VSFrame *src2, const VSFrame *props,
+    DpidFrameScratch &s, const VSAPI *vsapi) {
+
+    const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src1);
+    const bool is_float = fi->sampleType == stFloat;
+    const int num_levels = static_cast<int>(d->levels.size());
+
+    // indexed by level * 3 + plane
+    std::vector<DpidPlane> &planes = s.planes;
+    planes.assign(static_cast<size_t>(num_levels) * 3, DpidPlane{});
+    size_t avg_size = 0;
+    size_t reduced_size = 0;
+    size_t filtered_size = 0;
+    size_t weights_size = 0;
+
+
+    // shared_weights: the plane whose weight map a plane reads, the first
+    // processed one of its size
+    const auto mapPlane = [d, &planes](int level, int plane) {
+        const DpidGeometry &geometry = *planes[level * 3 + plane].geometry;
+
+        for (int j = 0; j < plane; ++j) {
+            // planes that are not processed have no geometry
+            if (!d->process[j])
+                continue;
+
+            const DpidGeometry &other = *planes[level * 3 + j].geometry;
+
+            if (other.x.src_size == geometry.x.src_size && other.y.src_size == geometry.y.src_size)
+                return j;
+        }
+
+        return plane;
+    };
+
+    for (int plane = 0; plane < fi->numPlanes; ++plane) {
+        if (!d->process[plane])
+            continue;
+
+        const int location = plane != 0 ? frameChromaLocation(d, props, vsapi) : 0;
+
+        for (int level = 0; level < num_levels; ++level) {
+            DpidPlane &p = planes[level * 3 + plane];
+            p.geometry = &d->levels[level].geometry[plane][location];
+            p.lambda = d->lambda[plane];
+
+            p.src1p = vsapi->getReadPtr(src1, plane);
+            p.src1_stride = vsapi->getStride(src1, plane) / fi->bytesPerSample;
+            p.dstp[0] = vsapi->getWritePtr(s.dst[level], plane);
+            p.dst_stride = vsapi->getStride(s.dst[level], plane) / fi->bytesPerSample;
+
+            for (size_t i = 1; i < d->sweep.size(); ++i)
+                p.dstp[i] = vsapi->getWritePtr(s.dst[i], plane);
+            p.avg_stride = dpidAvgStride(p.geometry->x.dst_size);
+
+            if (src2) {
+                p.src2p = vsapi->getReadPtr(src2, plane);
+                p.src2_stride = vsapi->getStride(src2, plane) / fi->bytesPerSample;
+                p.resize = nullptr;
+                p.blur = dpidGetBlur(fi->bytesPerSample, is_float, d->opt);
+            } else {
+                p.src2p = nullptr;
+                p.src2_stride = 0;
+                p.resize = dpidGetResize(fi->bytesPerSample, is_float, d->opt);
+                p.blur = dpidGetBlur(sizeof(float), true, d->opt);
+            }
+
+            p.lut = d->lut[plane].table.empty() ? nullptr : &d->lut[plane];
+            p.counters = d->stats ? d->levels[level].counters[plane][location].get() : nullptr;
+
+            if (d->shared_weights) {
+                p.kernel = nullptr;
+                p.sweep = nullptr;
+                p.shared = dpidGetSharedKernel(fi->bytesPerSample, is_float, d->opt, p.geometry->aligned);
+                p.weights = plane == 0 ? dpidGetWeights(fi->bytesPerSample, is_float, d->opt, d->shared_class) : nullptr;
+                p.guide_weight = d->guide_weight[plane];
+                p.weight_stride = dpidAvgStride(p.geometry->x.src_size);
+
+                if (mapPlane(level, plane) == plane)
+                    weights_size += static_cast<size_t>(p.weight_stride) * p.geometry->y.src_size;
+            } else if (useHistogram(d, d->levels[level], plane, *p.geometry, *fi)) {
+                p.kernel = dpidGetHistogramKernel(fi->bytesPerSample, d->opt, d->lambda_class[plane], p.geometry->aligned);
+                p.sweep = nullptr;
+            } else if (d->sweep.empty()) {
+                p.kernel = dpidGetKernel(
+                    fi->bytesPerSample, is_float, d->opt,
+                    d->lambda_class[plane], p.geometry->aligned);
+                p.sweep = nullptr;
+            } else {
+                p.kernel = nullptr;
+                p.sweep = dpidGetSweepKernel(
+                    fi->bytesPerSample, is_float, d->opt,
+                    d->lambda_class[plane] == DPID_LAMBDA_FAST, p.geometry->aligned);
+            }
+
+            if (d->levels[level].reduce > 1) {
+                // the reduced source is float, which has no table
+                const int lambda_class = p.lut ? dpidLambdaClass(p.lambda) : d->lambda_class[plane];
+
+                p.reduce = dpidGetReduce(fi->bytesPerSample, is_float, d->opt, d->lambda_class[plane]);
+                p.factor = d->levels[level].reduce;
+                p.src1_w = vsapi->getFrameWidth(src1, plane);
+                p.src1_h = vsapi->getFrameHeight(src1, plane);
+                p.reduced_stride = dpidAvgStride(p.geometry->x.src_size);
+                p.resize = dpidGetResize(sizeof(float), true, d->opt);
+                p.kernel = dpidGetKernel(sizeof(float), true, d->opt, lambda_class, p.geometry->aligned);
+                p.store = dpidGetStore(fi->bytesPerSample, is_float);
+
+                reduced_size += static_cast<size_t>(p.reduced_stride) * p.geometry->y.src_size;
+                filtered_size += static_cast<size_t>(p.avg_stride) * p.geometry->y.dst_size;
+            }
+
+            avg_size += static_cast<size_t>(p.avg_stride) * p.geometry->y.dst_size;
+        }
+    }
+
+    // guide planes; `down` is the internal bilinear guide of Dpid. Every row
+    // is written before it is read, except for the padding of the strides.
+    s.avg.resize(avg_size);
+    s.down.resize(src2 ? 0 : avg_size);
+    s.reduced.resize(reduced_size);
+    s.filtered.resize(filtered_size);
+    s.weights.resize(weights_size);
+
+    // A task filters a band of rows of the band level, and the rows of the
+    // other levels whose footprints start in the same source rows, so every
+    // level reads the source rows while they are still in cache. The bands of
+    // task `i` are bands[tasks[i]] to bands[tasks[i + 1] - 1].
+    std::vector<DpidBand> &bands = s.bands;
+    std::vector<size_t> &tasks = s.tasks;
+    bands.clear();
+    tasks.clear();
+    size_t offset = 0;
+    size_t reduced_offset = 0;
+    size_t filtered_offset = 0;
+    size_t weights_offset = 0;
+    bool shrink = false;
+
+    for (int plane = 0; plane < fi->numPlanes; ++plane) {
+        if (!d->process[plane])
+            continue;
+
+        for (int level = 0; level < num_levels; ++level) {
+            DpidPlane &p = planes[level * 3 + plane];
+            p.avgp = s.avg.data() + offset;
+            p.downp = src2 ? nullptr : s.down.data() + offset;
+            offset += static_cast<size_t>(p.avg_stride) * p.geometry->y.dst_size;
+
+            if (p.reduce) {
+                p.reducedp = s.reduced.data() + reduced_offset;
+                p.filteredp = s.filtered.data() + filtered_offset;
+                reduced_offset += static_cast<size_t>(p.reduced_stride) * p.geometry->y.src_size;
+                filtered_offset += static_cast<size_t>(p.avg_stride) * p.geometry->y.dst_size;
+            }
+
+            if (p.shared) {
+                const int map_plane = mapPlane(level, plane);
+
+                if (map_plane == plane) {
+                    p.weightp = s.weights.data() + weights_offset;
+                    p.shrink_from = plane != 0 ? &planes[level * 3] : nullptr;
+                    weights_offset += static_cast<size_t>(p.weight_stride) * p.geometry->y.src_size;
+                    shrink = shrink || p.shrink_from;
+                } else {
+                    p.weightp = planes[level * 3 + map_plane].weightp;
+                }
+            }
+
+            if (d->levels[level].rgb_guide && plane != 0) {
+                DpidPlane &lead = planes[level * 3];
+                lead.band_planes[lead.num_band_planes++] = &p;
+                p.joined = true;
+            } else {
+                p.band_planes[0] = &p;
+                p.num_band_planes = 1;
+            }
+        }
+
+        const DpidAxis &band_axis = planes[d->band_level * 3 + plane].geometry->y;
+
+        for (int y = 0; y < band_axis.dst_size; y += d->band_rows) {
+            const size_t task = bands.size();
+
+            for (int level = 0; level < num_levels; ++level) {
+                const DpidPlane &p = planes[level * 3 + plane];
+                const int y_begin = firstRow(p.geometry->y, band_axis, y);
+                const int y_end = firstRow(p.geometry->y, band_axis, y + d->band_rows);
 
-    for (int outer_y = 0; outer_y < dst_h; ++outer_y) {
-        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+                if (y_begin < y_end && !p.joined)
+                    bands.push_back({&p, y_begin, y_end});
+            }
+
+            if (bands.size() > task)
+                tasks.push_back(task);
+        }
+    }
+
+    tasks.push_back(bands.size());
+    const int num_tasks = static_cast<int>(tasks.size()) - 1;
+
+    // hierarchical=True: the guide and the kernel read the reduced rows of
+    // other bands too. The bands split the reduced rows in proportion to
+    // their output rows.
+    if (reduced_size) {
+        runTasks(d, num_tasks, [d, &s](int i) {
+            DpidScratchPool<DpidScratch>::Lease scratch(d->pass_scratch);
 
-            // avg = RemoveGrain(down, 11)
-            float avg {};
-            for (int inner_y = -1; inner_y <= 1; ++inner_y) {
-                for (int inner_x = -1; inner_x <= 1; ++inner_x) {
+            for (size_t b = s.tasks[i]; b < s.tasks[i + 1]; ++b) {
+                const DpidBand &band = s.bands[b];
+                const DpidPlane &p = *band.plane;
+
+                if (!p.reduce)
+                    continue;
+
+                const int64_t start = p.counters ? nowNs() : 0;
+                const int64_t reduced_h = p.geometry->y.src_size;
+                const int64_t dst_h = p.geometry->y.dst_size;
+
+                p.reduce(p.src1p, p.src1_stride, p.src1_w, p.src1_h, p.reducedp, p.reduced_stride, p.factor,
+                    p.lambda, p.lut, static_cast<int>(band.y_begin * reduced_h / dst_h), static_cast<int>(band.y_end * reduced_h / dst_h), *scratch);
+
+                if (p.counters)
+                    p.counters->kernel_ns += nowNs() - start;
+            }
+        });
+    }
 
-                    int y = std::clamp(outer_y + inner_y, 0, dst_h - 1);
-                    int x = std::clamp(outer_x + inner_x, 0, dst_w - 1);
+    // the guide blur reads the rows around its band, so the internal
+    // guide has to be complete before any band is filtered
+    if (!src2) {
+        runTasks(d, num_tasks, [d, &s](int i) {
+            DpidScratchPool<DpidScratch>::Lease scratch(d->pass_scratch);
 
-                    T pixel = downp[y * down_stride + x];
-                    avg += pixel * (2 - std::abs(inner_y)) * (2 - std::abs(inner_x));
+            for (size_t b = s.tasks[i]; b < s.tasks[i + 1]; ++b) {
+                const DpidBand &band = s.bands[b];
+
+                for (int j = 0; j < band.plane->num_band_planes; ++j) {
+                    const DpidPlane &p = *band.plane->band_planes[j];
+                    const int64_t start = p.counters ? nowNs() : 0;
+
+                    if (p.reduce)
+                        p.resize(p.reducedp, p.reduced_stride, p.downp, p.avg_stride, *p.geometry, band.y_begin, band.y_end, *scratch);
+                    else
+                        p.resize(p.src1p, p.src1_stride, p.downp, p.avg_stride, *p.geometry, band.y_begin, band.y_end, *scratch);
+
+                    if (p.counters)
+                        p.counters->guide_ns += nowNs() - start;
                 }
             }
-            avg /= 16.f;
-
-            // Dpid
-            const float sx = std::clamp(outer_x * scale_x + src_left, 0.f, static_cast<float>(src_w));
-            const float ex = std::clamp((outer_x + 1) * scale_x + src_left, 0.f, static_cast<float>(src_w));
-            const float sy = std::clamp(outer_y * scale_y + src_top, 0.f, static_cast<float>(src_h));
-            const float ey = std::clamp((outer_y + 1) * scale_y + src_top, 0.f, static_cast<float>(src_h));
-
-            const int sxr = static_cast<int>(std::floor(sx));
-            const int exr = static_cast<int>(std::ceil(ex));
-            const int syr = static_cast<int>(std::floor(sy));
-            const int eyr = static_cast<int>(std::ceil(ey));
-
-            float sum_pixel {};
-            float sum_weight {};
-
-            for (int inner_y = syr; inner_y < eyr; ++inner_y) {
-                for (int inner_x = sxr; inner_x < exr; ++inner_x) {
-                    T pixel = srcp[inner_y * src_stride + inner_x];
-                    float distance = std::abs(avg - static_cast<float>(pixel));
-                    float weight = std::pow(distance, lambda);
-                    weight = contribution(weight, static_cast<float>(inner_x), static_cast<float>(inner_y), sx, ex, sy, ey);
-
-                    sum_pixel += weight * pixel;
-                    sum_weight += weight;
+        });
+    }
+
+    // shared_weights: the guide blur, and the weight map of the bands of the
+    // first plane. The kernels read the map around their bands like the
+    // guide blur reads its input, and so does the shrinking for smaller
+    // planes, whose maps are split between the bands in proportion to their
+    // output rows.
+    if (d->shared_weights) {
+        runTasks(d, num_tasks, [d, &s](int i) {
+            DpidScratchPool<DpidScratch>::Lease scratch(d->pass_scratch);
+
+            for (size_t b = s.tasks[i]; b < s.tasks[i + 1]; ++b) {
+                const DpidBand &band = s.bands[b];
+                const DpidPlane &p = *band.plane;
+                const int dst_w = p.geometry->x.dst_size;
+                const int dst_h = p.geometry->y.dst_size;
+                const int64_t start = p.counters ? nowNs() : 0;
+
+                DpidGuidePlane guide[DPID_GUIDE_MAX];
+                int num_guide = 0;
+
+                for (int j = 0; j < p.num_band_planes; ++j) {
+                    const DpidPlane &q = *p.band_planes[j];
+
+                    if (q.downp)
+                        q.blur(q.downp, q.avg_stride, q.avgp, q.avg_stride, dst_w, dst_h, band.y_begin, band.y_end, *scratch);
+                    else
+                        q.blur(q.src2p, q.src2_stride, q.avgp, q.avg_stride, dst_w, dst_h, band.y_begin, band.y_end, *scratch);
+
+                    if (q.guide_weight != 0.0f)
+                        guide[num_guide++] = {q.src1p, q.src1_stride, q.avgp, q.guide_weight};
+                }
+
+                const int64_t blurred = p.counters ? nowNs() : 0;
+
+                if (p.weights)
+                    p.weights(guide, num_guide, p.avg_stride, *p.geometry, p.lambda, p.lut,
+                        p.weightp, p.weight_stride, band.y_begin, band.y_end, *scratch);
+
+                if (p.counters) {
+                    for (int j = 0; j < p.num_band_planes; ++j)
+                        p.band_planes[j]->counters->guide_ns += (blurred - start) / p.num_band_planes;
+                    p.counters->kernel_ns += nowNs() - blurred;
                 }
             }
+        });
+    }
+
+    if (shrink) {
+        runTasks(d, num_tasks, [d, &s, fi](int i) {
+            for (size_t b = s.tasks[i]; b < s.tasks[i + 1]; ++b) {
+                const DpidBand &band = s.bands[b];
+                const DpidPlane &p = *band.plane;
 
-            dstp[outer_y * dst_stride + outer_x] = static_cast<T>((sum_weight == 0.f) ? avg : sum_pixel / sum_weight);
+                if (!p.shrink_from)
+                    continue;
+
+                const int64_t start = p.counters ? nowNs() : 0;
+                const int64_t src_h = p.geometry->y.src_size;
+                const int64_t dst_h = p.geometry->y.dst_size;
+
+                dpidShrinkWeights(p.shrink_from->weightp, p.shrink_from->weight_stride, p.weightp, p.weight_stride,
+                    p.geometry->x.src_size, fi->subSamplingW, fi->subSamplingH,
+                    static_cast<int>(band.y_begin * src_h / dst_h), static_cast<int>(band.y_end * src_h / dst_h));
+
+                if (p.counters)
+                    p.counters->kernel_ns += nowNs() - start;
+            }
+        });
+    }
+
+    runTasks(d, num_tasks, [d, &s](int i) {
+        DpidScratchPool<DpidScratch>::Lease scratch(d->pass_scratch);
+
+        for (size_t b = s.tasks[i]; b < s.tasks[i + 1]; ++b) {
+            const DpidBand &band = s.bands[b];
+            for (int j = 0; j < band.plane->num_band_planes; ++j) {
+                const DpidPlane &p = *band.plane->band_planes[j];
+                const int dst_w = p.geometry->x.dst_size;
+                const int dst_h = p.geometry->y.dst_size;
+                const int64_t start = p.counters ? nowNs() : 0;
+
+                // shared_weights blurred the guide with the weight map
+                if (!p.shared) {
+                    if (p.downp)
+                        p.blur(p.downp, p.avg_stride, p.avgp, p.avg_stride, dst_w, dst_h, band.y_begin, band.y_end, *scratch);
+                    else
+                        p.blur(p.src2p, p.src2_stride, p.avgp, p.avg_stride, dst_w, dst_h, band.y_begin, band.y_end, *scratch);
+                }
+
+                const int64_t blurred = p.counters ? nowNs() : 0;
+
+                if (p.shared) {
+                    p.shared(
+                        p.src1p, p.src1_stride,
+                        p.avgp, p.avg_stride,
+                        p.weightp, p.weight_stride,
+                        p.dstp[0], p.dst_stride,
+                        *p.geometry, band.y_begin, band.y_end, *scratch);
+                } else if (p.sweep) {
+                    p.sweep(
+                        p.src1p, p.src1_stride,
+                        p.avgp, p.avg_stride,
+                        p.dstp, p.dst_stride,
+                        *p.geometry, d->sweep.data(), static_cast<int>(d->sweep.size()), band.y_begin, band.y_end, *scratch);
+                } else if (p.reduce) {
+                    p.kernel(
+                        p.reducedp, p.reduced_stride,
+                        p.avgp, p.avg_stride,
+                        p.filteredp, p.avg_stride,
+                        *p.geometry, p.lambda, nullptr, band.y_begin, band.y_end, *scratch);
+                    p.store(p.filteredp, p.avg_stride, p.dstp[0], p.dst_stride, dst_w, band.y_begin, band.y_end);
+                } else {
+                    p.kernel(
+                        p.src1p, p.src1_stride,
+                        p.avgp, p.avg_stride,
+                        p.dstp[0], p.dst_stride,
+                        *p.geometry, p.lambda, p.lut, band.y_begin, band.y_end, *scratch);
+                }
+
+                if (p.counters) {
+                    p.counters->guide_ns += blurred - start;
+                    p.counters->kernel_ns += nowNs() - blurred;
+
+                    int64_t rows = 0;
+                    for (int y = band.y_begin; y < band.y_end; ++y)
+                        rows += p.geometry->y.end[y] - p.geometry->y.begin[y];
+                    p.counters->footprint += rows * p.counters->footprint_row;
+                }
+            }
+        }
+    });
+
+    for (const DpidPlane &p : planes) {
+        if (p.counters) {
+            ++p.counters->frames;
+            p.counters->pixels += static_cast<int64_t>(p.geometry->x.dst_size) * p.geometry->y.dst_size;
         }
     }
 }
@@ -99,11 +994,15 @@ static const VSFrame *VS_CC dpidGetframe(int n, int activationReason, void *inst
 
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node1, frameCtx);
-        vsapi->requestFrameFilter(n, d->node2, frameCtx);
+        if (d->node2)
+            vsapi->requestFrameFilter(n, d->node2, frameCtx);
     } else if (activationReason == arAllFramesReady) {
         const VSFrame *src1 = vsapi->getFrameFilter(n, d->node1, frameCtx);
-        const VSFrame *src2 = vsapi->getFrameFilter(n, d->node2, frameCtx);
-        const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src2);
+        const VSFrame *src2 = d->node2 ? vsapi->getFrameFilter(n, d->node2, frameCtx) : nullptr;
+        const VSVideoFormat *fi = vsapi->getVideoFrameFormat(src1);
+
+        // frame properties and unprocessed planes come from the guide clip
+        const VSFrame *props = src2 ? src2 : src1;
 
         const VSFrame * fr[] = {
             d->process[0] ? nullptr : src2, 
@@ -112,95 +1011,67 @@ static const VSFrame *VS_CC dpidGetframe(int n, int activationReason, void *inst
 
         constexpr int pl[] = {0, 1, 2};
 
-        VSFrame *dst = vsapi->newVideoFrame2(
-            fi, vsapi->getFrameWidth(src2, 0), vsapi->getFrameHeight(src2, 0), fr, pl, src2, core);
-
-        for (int plane = 0; plane < fi->numPlanes; ++plane) {
-            if (d->process[plane]) {
-                const void *src1p = vsapi->getReadPtr(src1, plane);
-                const int src1_stride = vsapi->getStride(src1, plane) / fi->bytesPerSample;
-                const void *src2p = vsapi->getReadPtr(src2, plane);
-                const int src2_stride = vsapi->getStride(src2, plane) / fi->bytesPerSample;
-                void *dstp = vsapi->getWritePtr(dst, plane);
-                const int dst_stride = vsapi->getStride(dst, plane) / fi->bytesPerSample;
-
-                const int src_w = vsapi->getFrameWidth(src1, plane);
-                const int src_h = vsapi->getFrameHeight(src1, plane);
-                const int dst_w = vsapi->getFrameWidth(src2, plane);
-                const int dst_h = vsapi->getFrameHeight(src2, plane);
-
-                const float hSubS = plane == 0 ? 1.0f : static_cast<float>(1 << fi->subSamplingW);
-                const float vSubS = plane == 0 ? 1.0f : static_cast<float>(1 << fi->subSamplingH);
-
-                float src_left, src_top;
-
-                float src_width = d->src_width[plane] / hSubS;
-                if (src_width == 0.0f)
-                    src_width = static_cast<float>(src_w);
-                float src_height = d->src_height[plane] / vSubS;
-                if (src_height == 0.0f)
-                    src_height = static_cast<float>(src_h);
-
-                if (plane != 0 && d->read_chromaloc) { 
-                    int chromaLocation;
-
-                    {
-                        int err;
-
-                        chromaLocation = vsh::int64ToIntS(vsapi->mapGetInt(vsapi->getFramePropertiesRO(src2), "_ChromaLocation", 0, &err));
-                        if (err) {
-                            chromaLocation = 0;
-                        }
-                    }
-
-                    const float hCPlace = (chromaLocation == 0 || chromaLocation == 2 || chromaLocation == 4) 
-                        ? (0.5f - hSubS / 2) : 0.f;
-                    const float hScale = static_cast<float>(dst_w) / src_width;
-
-                    const float vCPlace = (chromaLocation == 2 || chromaLocation == 3) 
-                        ? (0.5f - vSubS / 2) : ((chromaLocation == 4 || chromaLocation == 5) ? (vSubS / 2 - 0.5f) : 0.f);
-                    const float vScale = static_cast<float>(dst_h) / src_height;
-
-                    src_left = ((d->src_left[plane] - hCPlace) * hScale + hCPlace) / hScale / hSubS;
-                    src_top = ((d->src_top[plane] - vCPlace) * vScale + vCPlace) / vScale / vSubS;
-                } else {
-                    src_left = d->src_left[plane];
-                    src_top = d->src_top[plane];
-                }
+        const int num_outputs = numOutputs(d);
+
+        DpidScratchPool<DpidFrameScratch>::Lease scratch(d->frame_scratch);
+        std::vector<VSFrame *> &dst = scratch->dst;
+        dst.assign(num_outputs, nullptr);
+
+        const int64_t start = d->stats ? nowNs() : 0;
+
+        DpidCacheKey key {src1, src2, {d->process[0], d->process[1], d->process[2]}, frameChromaLocation(d, props, vsapi)};
+        const std::shared_ptr<const DpidCacheEntry> cached = d->cache ? d->cache->find(key) : nullptr;
+
+        if (cached) {
+            // the planes of the cached frames with the properties of this one
+            for (int i = 0; i < num_outputs; ++i) {
+                const VSFrame *c = cached->dst[i];
+                const VSFrame *planes[] = {c, c, c};
+                const DpidLevel &level = outputLevel(d, i);
 
-                // process
-                if (fi->sampleType == stInteger) {
-                    if (fi->bytesPerSample == 1) {
-                        dpidProcess(
-                            reinterpret_cast<const uint8_t *>(src1p), src1_stride, 
-                            reinterpret_cast<const uint8_t *>(src2p), src2_stride, 
-                            reinterpret_cast<uint8_t *>(dstp), dst_stride, 
-                            src_w, src_h, dst_w, dst_h, d->lambda[plane], 
-                            src_left, src_top, src_width, src_height);
-                    } else if (fi->bytesPerSample == 2) {
-                        dpidProcess(
-                            reinterpret_cast<const uint16_t *>(src1p), src1_stride, 
-                            reinterpret_cast<const uint16_t *>(src2p), src2_stride, 
-                            reinterpret_cast<uint16_t *>(dstp), dst_stride, 
-                            src_w, src_h, dst_w, dst_h, d->lambda[plane], 
-                            src_left, src_top, src_width, src_height);
-                    }
-                } else if (fi->sampleType == stFloat) {
-                    if (fi->bytesPerSample == 4) {
-                        dpidProcess(
-                            reinterpret_cast<const float *>(src1p), src1_stride, 
-                            reinterpret_cast<const float *>(src2p), src2_stride, 
-                            reinterpret_cast<float *>(dstp), dst_stride, 
-                            src_w, src_h, dst_w, dst_h, d->lambda[plane], 
-                            src_left, src_top, src_width, src_height);
-                    }
+                dst[i] = vsapi->newVideoFrame2(fi, level.dst_w, level.dst_h, planes, pl, props, core);
+            }
+        } else {
+            for (int i = 0; i < num_outputs; ++i) {
+                const DpidLevel &level = outputLevel(d, i);
+                dst[i] = vsapi->newVideoFrame2(fi, level.dst_w, level.dst_h, fr, pl, props, core);
+            }
+
+            ++d->frames_in_flight;
+            filterFrame(d, src1, src2, props, *scratch, vsapi);
+            --d->frames_in_flight;
+
+            if (d->cache)
+                d->cache->insert(key, dst, core);
+        }
+
+        if (d->stats) {
+            const int64_t time = nowNs() - start;
+
+            for (int i = 0; i < num_outputs; ++i) {
+                int64_t pixels = 0;
+                for (int plane = 0; plane < fi->numPlanes; ++plane) {
+                    if (d->process[plane])
+                        pixels += static_cast<int64_t>(vsapi->getFrameWidth(dst[i], plane)) * vsapi->getFrameHeight(dst[i], plane);
                 }
+
+                VSMap *dst_props = vsapi->getFramePropertiesRW(dst[i]);
+                vsapi->mapSetInt(dst_props, "_DpidTimeNs", time, maReplace);
+                vsapi->mapSetInt(dst_props, "_DpidPixels", pixels, maReplace);
+                if (d->cache)
+                    vsapi->mapSetInt(dst_props, "_DpidCached", cached ? 1 : 0, maReplace);
             }
         }
 
+        // DpidMulti and DpidSweep: the other outputs travel with the first one
+        // to the nodes returned to the user
+        for (int i = 1; i < num_outputs; ++i)
+            vsapi->mapConsumeFrame(vsapi->getFramePropertiesRW(dst[0]), levelKey(i).c_str(), dst[i], maReplace);
+
         vsapi->freeFrame(src1);
-        vsapi->freeFrame(src2);
-        return dst;
+        if (src2)
+            vsapi->freeFrame(src2);
+        return dst[0];
     }
 
     return nullptr;
@@ -210,27 +1081,97 @@ static void VS_CC dpidNodeFree(void *instanceData, VSCore *core, const VSAPI *vs
     DpidData *d = reinterpret_cast<DpidData *>(instanceData);
 
     vsapi->freeNode(d->node1);
-    vsapi->freeNode(d->node2);
+    if (d->node2)
+        vsapi->freeNode(d->node2);
+    delete d;
+}
+
+// one output of DpidMulti, taken from the frame computing all levels
+static const VSFrame *VS_CC dpidLevelGetframe(int n, int activationReason, void *instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    DpidLevelData *d = reinterpret_cast<DpidLevelData *>(instanceData);
+
+    if (activationReason == arInitial) {
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        const VSFrame *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+
+        if (d->level == 0) {
+            VSFrame *dst = vsapi->copyFrame(src, core);
+            VSMap *props = vsapi->getFramePropertiesRW(dst);
+
+            for (int level = 1; level < d->num_levels; ++level)
+                vsapi->mapDeleteKey(props, levelKey(level).c_str());
+
+            vsapi->freeFrame(src);
+            return dst;
+        }
+
+        const VSFrame *dst = vsapi->mapGetFrame(vsapi->getFramePropertiesRO(src), levelKey(d->level).c_str(), 0, nullptr);
+        vsapi->freeFrame(src);
+        return dst;
+    }
+
+    return nullptr;
+}
+
+static void VS_CC dpidLevelFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    DpidLevelData *d = reinterpret_cast<DpidLevelData *>(instanceData);
+
+    vsapi->freeNode(d->node);
     delete d;
 }
 
 
+// DpidMulti and DpidSweep: one node computes every output of a frame from a
+// single read of the source; the returned nodes pick their output from its
+// frames. `vi` gives the format, the sizes are those of the outputs.
+static void createOutputNodes(std::unique_ptr<DpidData> d, const std::string &name, const VSVideoInfo *vi,
+    const VSFilterDependency *deps, int num_deps, VSMap *out, VSCore *core, const VSAPI *vsapi) {
+
+    const int num_outputs = numOutputs(d.get());
+
+    VSVideoInfo vi_dst = *vi;
+    vi_dst.width = d->levels[0].dst_w;
+    vi_dst.height = d->levels[0].dst_h;
+
+    std::vector<VSVideoInfo> vi_outputs(num_outputs, *vi);
+    for (int i = 0; i < num_outputs; ++i) {
+        vi_outputs[i].width = outputLevel(d.get(), i).dst_w;
+        vi_outputs[i].height = outputLevel(d.get(), i).dst_h;
+    }
+
+    VSNode *all = vsapi->createVideoFilter2(name.c_str(), &vi_dst, dpidGetframe, dpidNodeFree, fmParallel, deps, num_deps, d.get(), core);
+    d.release();
+
+    for (int i = 0; i < num_outputs; ++i) {
+        DpidLevelData *ld = new DpidLevelData{vsapi->addNodeRef(all), i, num_outputs};
+
+        VSFilterDependency level_deps[] = {
+            {ld->node, rpStrictSpatial},
+        };
+
+        vsapi->createVideoFilter(out, name.c_str(), &vi_outputs[i], dpidLevelGetframe, dpidLevelFree, fmParallel, level_deps, 1, ld, core);
+    }
+
+    vsapi->freeNode(all);
+}
+
+
 static void VS_CC dpidRawCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<DpidData> d = std::make_unique<DpidData>();
 
     d->node1 = vsapi->mapGetNode(in, "clip", 0, nullptr);
     d->node2 = vsapi->mapGetNode(in, "clip2", 0, nullptr);
     const VSVideoInfo *vi = vsapi->getVideoInfo(d->node2);
-    d->dst_w = vi->width;
-    d->dst_h = vi->height;
-
-    int err;
+    d->levels.resize(1);
+    d->levels[0].dst_w = vi->width;
+    d->levels[0].dst_h = vi->height;
 
     try {
         if (!vsh::isConstantVideoFormat(vi) ||
             (vi->format.sampleType == stInteger && vi->format.bitsPerSample > 16) ||
-            (vi->format.sampleType == stFloat && vi->format.bitsPerSample != 32))
-            throw std::string{"only constant format 8-16 bit integer and 32 bit float input supported"};
+            (vi->format.sampleType == stFloat && vi->format.bitsPerSample != 16 && vi->format.bitsPerSample != 32))
+            throw std::string{"only constant format 8-16 bit integer and 16/32 bit float input supported"};
 
 
         if (const VSVideoInfo *vi_src = vsapi->getVideoInfo(d->node1);
@@ -267,61 +1208,17 @@ static void VS_CC dpidRawCreate(const VSMap *in, VSMap *out, void *userData, VSC
             d->process[n] = true;
         }
 
-        const int numSrcLeft = vsapi->mapNumElements(in, "src_left");
-        if (numSrcLeft > vi->format.numPlanes)
-            throw std::string{"more \"src_left\" given than there are planes"};
+        createWindow(d.get(), in, vi->format, vsapi);
+        createOpt(d.get(), in, vsapi);
 
-        const int numSrcTop = vsapi->mapNumElements(in, "src_top");
-        if (numSrcTop > vi->format.numPlanes)
-            throw std::string{"more \"src_top\" given than there are planes"};
+        const VSVideoInfo *vi_src = vsapi->getVideoInfo(d->node1);
+        buildGeometry(d.get(), vi_src->format, vi_src->width, vi_src->height, false);
 
-        const int numSrcWidth = vsapi->mapNumElements(in, "src_width");
-        if (numSrcWidth > vi->format.numPlanes)
-            throw std::string{"more \"src_width\" given than there are planes"};
-
-        const int numSrcHeight = vsapi->mapNumElements(in, "src_height");
-        if (numSrcHeight > vi->format.numPlanes)
-            throw std::string{"more \"src_height\" given than there are planes"};
-
-        for (int i = 0; i < 3; i++) {
-            if (i < numSrcLeft)
-                d->src_left[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_left", i, nullptr));
-            else if (i == 0)
-                d->src_left[0] = 0.0f;
-            else 
-                d->src_left[i] = d->src_left[i-1];
-
-            if (i < numSrcTop)
-                d->src_top[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_top", i, nullptr));
-            else if (i == 0)
-                d->src_top[0] = 0.0f;
-            else 
-                d->src_top[i] = d->src_top[i-1];
-
-            if (i < numSrcWidth) {
-                d->src_width[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_width", i, nullptr));
-                if (d->src_width[i] < 0.0f)
-                    throw std::string{"active window set by \"src_width\" must be positive"};
-            } else if (i == 0)
-                d->src_width[0] = 0.0f;
-            else
-                d->src_width[i] = d->src_width[i - 1];
-
-            if (i < numSrcHeight) {
-                d->src_height[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_height", i, nullptr));
-                if (d->src_height[i] < 0.0f)
-                    throw std::string{"active window set by \"src_height\" must be positive"};
-            } else if (i == 0)
-                d->src_height[0] = 0.0f;
-            else
-                d->src_height[i] = d->src_height[i - 1];
-        }
-
-        d->read_chromaloc = static_cast<bool>(vsapi->mapGetInt(in, "read_chromaloc", 0, &err));
-
-        if (err) {
-            d->read_chromaloc = true;
-        }
+        createRange(d.get(), in, vi->format, vsapi);
+        createShared(d.get(), in, vi->format, vsapi);
+        createPool(d.get(), in, core, vsapi);
+        createCache(d.get(), in, vsapi);
+        createStats(d.get(), in, vi->format, "DpidRaw", vsapi);
 
     } catch (const std::string &error) {
         vsapi->mapSetError(out, ("DpidRaw: " + error).c_str());
@@ -340,7 +1237,11 @@ static void VS_CC dpidRawCreate(const VSMap *in, VSMap *out, void *userData, VSC
 }
 
 
+// Creates Dpid, or DpidMulti when `userData` is its name.
 static void VS_CC dpidCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    const std::string name = userData ? static_cast<const char *>(userData) : "Dpid";
+    const bool multi = userData != nullptr;
+
     std::unique_ptr<DpidData> d = std::make_unique<DpidData>();
 
     VSNode *node = vsapi->mapGetNode(in, "clip", 0, nullptr);
@@ -353,30 +1254,38 @@ static void VS_CC dpidCreate(const VSMap *in, VSMap *out, void *userData, VSCore
     try {
         if (!vsh::isConstantVideoFormat(vi) ||
             (vi->format.sampleType == stInteger && vi->format.bitsPerSample > 16) ||
-            (vi->format.sampleType == stFloat && vi->format.bitsPerSample != 32))
-            throw std::string{"only constant format 8-16 bit integer and 32 bit float input supported"};
+            (vi->format.sampleType == stFloat && vi->format.bitsPerSample != 16 && vi->format.bitsPerSample != 32))
+            throw std::string{"only constant format 8-16 bit integer and 16/32 bit float input supported"};
 
         // read arguments
-        d->dst_w = vsh::int64ToIntS(vsapi->mapGetInt(in, "width", 0, &err));
-        if (err) {
-            d->dst_w = vi->width;
-        }
+        if (multi) {
+            const int numWidth = vsapi->mapNumElements(in, "width");
+            const int numHeight = vsapi->mapNumElements(in, "height");
 
-        d->dst_h = vsh::int64ToIntS(vsapi->mapGetInt(in, "height", 0, &err));
-        if (err) {
-            d->dst_h = vi->height;
-        }
+            if (numWidth <= 0 && numHeight <= 0)
+                throw std::string{"at least one output size must be given"};
 
-        if (d->dst_w == 0 && d->dst_h == 0)
-            throw std::string{"\"width\" and \"height\" can not be equal to 0 at the same time"};
-        else if (d->dst_w == 0)
-            d->dst_w = vi->width * d->dst_h / vi->height;
-        else if (d->dst_h == 0)
-            d->dst_h = vi->height * d->dst_w / vi->width;
+            if (numWidth > 0 && numHeight > 0 && numWidth != numHeight)
+                throw std::string{"\"width\" and \"height\" must have the same number of elements"};
 
-        if (d->dst_w == vi->width && d->dst_h == vi->height) 
-            throw std::string{"dimensions of output is identical to input. "
-                "Please consider remove the function call"};
+            for (int i = 0; i < std::max(numWidth, numHeight); ++i) {
+                const int dst_w = i < numWidth ? vsh::int64ToIntS(vsapi->mapGetInt(in, "width", i, nullptr)) : 0;
+                const int dst_h = i < numHeight ? vsh::int64ToIntS(vsapi->mapGetInt(in, "height", i, nullptr)) : 0;
+                d->levels.push_back(makeLevel(dst_w, dst_h, vi));
+            }
+        } else {
+            int dst_w = vsh::int64ToIntS(vsapi->mapGetInt(in, "width", 0, &err));
+            if (err) {
+                dst_w = vi->width;
+            }
+
+            int dst_h = vsh::int64ToIntS(vsapi->mapGetInt(in, "height", 0, &err));
+            if (err) {
+                dst_h = vi->height;
+            }
+
+            d->levels.push_back(makeLevel(dst_w, dst_h, vi));
+        }
 
         const int numLambda = vsapi->mapNumElements(in, "lambda");
         if (numLambda > vi->format.numPlanes)
@@ -394,103 +1303,186 @@ static void VS_CC dpidCreate(const VSMap *in, VSMap *out, void *userData, VSCore
         for (int i = 0; i < 3; i++)
             d->process[i] = true;
 
-        const int numSrcLeft = vsapi->mapNumElements(in, "src_left");
-        if (numSrcLeft > vi->format.numPlanes)
-            throw std::string{"more \"src_left\" given than there are planes"};
+        createWindow(d.get(), in, vi->format, vsapi);
+        createOpt(d.get(), in, vsapi);
 
-        const int numSrcTop = vsapi->mapNumElements(in, "src_top");
-        if (numSrcTop > vi->format.numPlanes)
-            throw std::string{"more \"src_top\" given than there are planes"};
+        d->hierarchical = !!vsapi->mapGetInt(in, "hierarchical", 0, &err);
 
-        const int numSrcWidth = vsapi->mapNumElements(in, "src_width");
-        if (numSrcWidth > vi->format.numPlanes)
-            throw std::string{"more \"src_width\" given than there are planes"};
+        buildGeometry(d.get(), vi->format, vi->width, vi->height, true);
 
-        const int numSrcHeight = vsapi->mapNumElements(in, "src_height");
-        if (numSrcHeight > vi->format.numPlanes)
-            throw std::string{"more \"src_height\" given than there are planes"};
+        createRange(d.get(), in, vi->format, vsapi);
+        createShared(d.get(), in, vi->format, vsapi);
+        createPool(d.get(), in, core, vsapi);
+        createCache(d.get(), in, vsapi);
+        createStats(d.get(), in, vi->format, name, vsapi);
 
-        for (int i = 0; i < 3; i++) {
-            if (i < numSrcLeft)
-                d->src_left[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_left", i, nullptr));
-            else if (i == 0)
-                d->src_left[0] = 0.0f;
-            else 
-                d->src_left[i] = d->src_left[i-1];
+        // the guide is a bilinear downscale computed by the filter itself
+        d->node2 = nullptr;
 
-            if (i < numSrcTop)
-                d->src_top[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_top", i, nullptr));
-            else if (i == 0)
-                d->src_top[0] = 0.0f;
-            else 
-                d->src_top[i] = d->src_top[i-1];
-
-            if (i < numSrcWidth) {
-                d->src_width[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_width", i, nullptr));
-                if (d->src_width[i] < 0.0f)
-                    throw std::string{"active window set by \"src_width\" must be positive"};
-            } else if (i == 0)
-                d->src_width[0] = 0.0f;
-            else
-                d->src_width[i] = d->src_width[i - 1];
-
-            if (i < numSrcHeight) {
-                d->src_height[i] = static_cast<float>(vsapi->mapGetFloat(in, "src_height", i, nullptr));
-                if (d->src_height[i] < 0.0f)
-                    throw std::string{"active window set by \"src_height\" must be positive"};
-            } else if (i == 0)
-                d->src_height[0] = 0.0f;
-            else
-                d->src_height[i] = d->src_height[i - 1];
-        }
+        VSVideoInfo vi_dst = *vi;
+        vi_dst.width = d->levels[0].dst_w;
+        vi_dst.height = d->levels[0].dst_h;
 
-        d->read_chromaloc = static_cast<bool>(vsapi->mapGetInt(in, "read_chromaloc", 0, &err));
-        if (err) {
-            d->read_chromaloc = true;
-        }
+        VSFilterDependency deps[] = {
+            {d->node1, rpStrictSpatial},
+        };
 
-        // preprocess
-        VSMap * vtmp1 = vsapi->createMap();
-        vsapi->mapSetNode(vtmp1, "clip", node, maReplace);
-        vsapi->mapSetInt(vtmp1, "width", d->dst_w, maReplace);
-        vsapi->mapSetInt(vtmp1, "height", d->dst_h, maReplace);
-        vsapi->mapSetFloat(vtmp1, "src_left", d->src_left[0], maReplace);
-        vsapi->mapSetFloat(vtmp1, "src_top", d->src_top[0], maReplace);
-        if (d->src_width[0] != 0.0f)
-            vsapi->mapSetFloat(vtmp1, "src_width", d->src_width[0], maReplace);
-        if (d->src_height[0] != 0.0f)
-            vsapi->mapSetFloat(vtmp1, "src_height", d->src_height[0], maReplace);
-
-        VSMap * vtmp2 = vsapi->invoke(vsapi->getPluginByNamespace("resize", core), "Bilinear", vtmp1);
-        if (vsapi->mapGetError(vtmp2)) {
-            vsapi->mapSetError(out, vsapi->mapGetError(vtmp2));
-            vsapi->freeMap(vtmp1);
-            vsapi->freeMap(vtmp2);
+        if (!multi) {
+            vsapi->createVideoFilter(out, "Dpid", &vi_dst, dpidGetframe, dpidNodeFree, fmParallel, deps, 1, d.get(), core);
+            d.release();
             return;
         }
-        vsapi->freeMap(vtmp1);
 
-        node = vsapi->mapGetNode(vtmp2, "clip", 0, nullptr);
+        createOutputNodes(std::move(d), name, vi, deps, 1, out, core, vsapi);
+    } catch (const std::string &error) {
+        vsapi->mapSetError(out, (name + ": " + error).c_str());
+        vsapi->freeNode(node);
+        return;
+    }
+}
 
-        d->node2 = node;
 
-        VSFilterDependency deps[] = {
-            {d->node1, rpStrictSpatial},
-            {d->node2, rpStrictSpatial},
-        };
-        
-        vsapi->createVideoFilter(out, "DpidRaw", vsapi->getVideoInfo(d->node2), dpidGetframe, dpidNodeFree, fmParallel, deps, 2, d.get(), core);
-        d.release();
+// DpidSweep: the output of every lambda value from one pass, with the guide of
+// "clip2" like DpidRaw or computed internally like Dpid.
+static void VS_CC dpidSweepCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    std::unique_ptr<DpidData> d = std::make_unique<DpidData>();
+
+    int err;
+
+    d->node1 = vsapi->mapGetNode(in, "clip", 0, nullptr);
+    d->node2 = vsapi->mapGetNode(in, "clip2", 0, &err);
+
+    const VSVideoInfo *vi = vsapi->getVideoInfo(d->node1);
+
+    try {
+        if (!vsh::isConstantVideoFormat(vi) ||
+            (vi->format.sampleType == stInteger && vi->format.bitsPerSample > 16) ||
+            (vi->format.sampleType == stFloat && vi->format.bitsPerSample != 16 && vi->format.bitsPerSample != 32))
+            throw std::string{"only constant format 8-16 bit integer and 16/32 bit float input supported"};
+
+        const int numLambda = vsapi->mapNumElements(in, "lambda");
+        if (numLambda < 1 || numLambda > DPID_SWEEP_MAX)
+            throw std::string{"\"lambda\" must have 1 to " + std::to_string(DPID_SWEEP_MAX) + " elements"};
+
+        for (int i = 0; i < numLambda; ++i)
+            d->sweep.push_back(static_cast<float>(vsapi->mapGetFloat(in, "lambda", i, nullptr)));
 
-        vsapi->freeMap(vtmp2);
+        for (int i = 0; i < 3; i++)
+            d->lambda[i] = d->sweep[0];
+
+        const int numPlanes = vsapi->mapNumElements(in, "planes");
+        if (numPlanes > 0 && !d->node2)
+            throw std::string{"\"planes\" requires \"clip2\""};
+
+        for (int i = 0; i < 3; i++)
+            d->process[i] = (numPlanes <= 0);
+
+        for (int i = 0; i < numPlanes; i++) {
+            const int n = vsh::int64ToIntS(vsapi->mapGetInt(in, "planes", i, nullptr));
+
+            if (n < 0 || n >= vi->format.numPlanes)
+                throw std::string{"plane index out of range"};
+
+            if (d->process[n])
+                throw std::string{"plane specified twice"};
+
+            d->process[n] = true;
+        }
+
+        if (d->node2) {
+            const VSVideoInfo *vi_guide = vsapi->getVideoInfo(d->node2);
+
+            if (!vsh::isSameVideoFormat(&vi->format, &vi_guide->format) || (vi->numFrames != vi_guide->numFrames))
+                throw std::string{"\"clip\" and \"clip2\" must be of the same format and number of frames"};
+
+            if (vsapi->mapNumElements(in, "width") > 0 || vsapi->mapNumElements(in, "height") > 0)
+                throw std::string{"the output size is the one of \"clip2\", \"width\" and \"height\" must not be given"};
+
+            d->levels.resize(1);
+            d->levels[0].dst_w = vi_guide->width;
+            d->levels[0].dst_h = vi_guide->height;
+        } else {
+            int dst_w = vsh::int64ToIntS(vsapi->mapGetInt(in, "width", 0, &err));
+            if (err)
+                dst_w = vi->width;
+
+            int dst_h = vsh::int64ToIntS(vsapi->mapGetInt(in, "height", 0, &err));
+            if (err)
+                dst_h = vi->height;
+
+            d->levels.push_back(makeLevel(dst_w, dst_h, vi));
+        }
+
+        createWindow(d.get(), in, vi->format, vsapi);
+        createOpt(d.get(), in, vsapi);
+
+        buildGeometry(d.get(), vi->format, vi->width, vi->height, !d->node2);
+
+        createRange(d.get(), in, vi->format, vsapi);
+        createPool(d.get(), in, core, vsapi);
+        createCache(d.get(), in, vsapi);
+        createStats(d.get(), in, vi->format, "DpidSweep", vsapi);
     } catch (const std::string &error) {
-        vsapi->mapSetError(out, ("Dpid: " + error).c_str());
-        vsapi->freeNode(node);
+        vsapi->mapSetError(out, ("DpidSweep: " + error).c_str());
+        vsapi->freeNode(d->node1);
+        vsapi->freeNode(d->node2);
         return;
     }
+
+    VSFilterDependency deps[] = {
+        {d->node1, rpStrictSpatial},
+        {d->node2, rpStrictSpatial},
+    };
+
+    createOutputNodes(std::move(d), "DpidSweep", vi, deps, deps[1].source ? 2 : 1, out, core, vsapi);
 }
 
 
+// dpid.Stats(): the counters of the filters created with stats=True
+static void VS_CC dpidStats(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    int err;
+
+    const bool reset = !!vsapi->mapGetInt(in, "reset", 0, &err);
+
+    std::string report;
+
+    for (const auto &counters : dpidGetCounters()) {
+        const int64_t frames = counters->frames;
+        if (frames == 0)
+            continue;
+
+        const int64_t guide_ns = counters->guide_ns;
+        const int64_t kernel_ns = counters->kernel_ns;
+        const int64_t pixels = counters->pixels;
+        const double footprint = static_cast<double>(counters->footprint) / pixels;
+
+        vsapi->mapSetData(out, "filter", counters->filter.c_str(), -1, dtUtf8, maAppend);
+        vsapi->mapSetInt(out, "plane", counters->plane, maAppend);
+        vsapi->mapSetInt(out, "width", counters->width, maAppend);
+        vsapi->mapSetInt(out, "height", counters->height, maAppend);
+        vsapi->mapSetData(out, "variant", counters->variant.c_str(), -1, dtUtf8, maAppend);
+        vsapi->mapSetInt(out, "frames", frames, maAppend);
+        vsapi->mapSetInt(out, "guide_ns", guide_ns, maAppend);
+        vsapi->mapSetInt(out, "kernel_ns", kernel_ns, maAppend);
+        vsapi->mapSetInt(out, "pixels", pixels, maAppend);
+        vsapi->mapSetFloat(out, "footprint", footprint, maAppend);
+
+        char line[256];
+        snprintf(line, sizeof(line), "%s plane %d %dx%d %s: %lld frames, guide %.3f ms, kernel %.3f ms, %.2f ns/pixel, footprint %.1f\n",
+            counters->filter.c_str(), counters->plane, counters->width, counters->height, counters->variant.c_str(),
+            static_cast<long long>(frames), guide_ns * 1e-6 / frames, kernel_ns * 1e-6 / frames,
+            static_cast<double>(guide_ns + kernel_ns) / pixels, footprint);
+        report += line;
+    }
+
+    vsapi->mapSetData(out, "report", report.c_str(), -1, dtUtf8, maReplace);
+
+    if (reset)
+        dpidResetCounters();
+}
+
+static char dpidMultiName[] = "DpidMulti";
+
 VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI *vspapi) {
     vspapi->configPlugin("com.wolframrhodium.dpid", "dpid", "Rapid, Detail-Preserving Image Downscaling", VS_MAKE_VERSION(1, 0), VAPOURSYNTH_API_VERSION, 0, plugin);
 
@@ -503,7 +1495,14 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI
         "src_width:float[]:opt;"
         "src_height:float[]:opt;"
         "read_chromaloc:int:opt;"
-        "planes:int[]:opt;", 
+        "planes:int[]:opt;"
+        "opt:int:opt;"
+        "threads:int:opt;"
+        "lut:int:opt;"
+        "fast:int:opt;"
+        "stats:int:opt;"
+        "cache:int:opt;"
+        "shared_weights:int:opt;",
         "clip:vnode;", dpidRawCreate, 0, plugin);
 
     vspapi->registerFunction("Dpid", 
@@ -515,6 +1514,57 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit2(VSPlugin *plugin, const VSPLUGINAPI
         "src_top:float[]:opt;"
         "src_width:float[]:opt;"
         "src_height:float[]:opt;"
-        "read_chromaloc:int:opt;",
+        "read_chromaloc:int:opt;"
+        "opt:int:opt;"
+        "threads:int:opt;"
+        "lut:int:opt;"
+        "fast:int:opt;"
+        "stats:int:opt;"
+        "cache:int:opt;"
+        "hierarchical:int:opt;"
+        "shared_weights:int:opt;",
         "clip:vnode;", dpidCreate, 0, plugin);
+
+    vspapi->registerFunction("DpidMulti",
+        "clip:vnode;"
+        "width:int[]:opt;"
+        "height:int[]:opt;"
+        "lambda:float[]:opt;"
+        "src_left:float[]:opt;"
+        "src_top:float[]:opt;"
+        "src_width:float[]:opt;"
+        "src_height:float[]:opt;"
+        "read_chromaloc:int:opt;"
+        "opt:int:opt;"
+        "threads:int:opt;"
+        "lut:int:opt;"
+        "fast:int:opt;"
+        "stats:int:opt;"
+        "cache:int:opt;"
+        "hierarchical:int:opt;"
+        "shared_weights:int:opt;",
+        "clip:vnode[];", dpidCreate, dpidMultiName, plugin);
+
+    vspapi->registerFunction("DpidSweep",
+        "clip:vnode;"
+        "lambda:float[];"
+        "clip2:vnode:opt;"
+        "width:int:opt;"
+        "height:int:opt;"
+        "src_left:float[]:opt;"
+        "src_top:float[]:opt;"
+        "src_width:float[]:opt;"
+        "src_height:float[]:opt;"
+        "read_chromaloc:int:opt;"
+        "planes:int[]:opt;"
+        "opt:int:opt;"
+        "threads:int:opt;"
+        "fast:int:opt;"
+        "stats:int:opt;"
+        "cache:int:opt;",
+        "clip:vnode[];", dpidSweepCreate, 0, plugin);
+
+    vspapi->registerFunction("Stats",
+        "reset:int:opt;",
+        "any", dpidStats, 0, plugin);
 }
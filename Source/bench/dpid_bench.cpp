@@ -0,0 +1,679 @@
+// Standalone benchmark and differential test of the dpid passes.
+//
+// Times the internal guide (resize + blur) and the kernel separately on
+// synthetic planes for every supported instruction set, and compares the
+// output against the C reference (opt=1). The guide blur and the kernel of
+// every instruction set are also compared with the per pixel algorithm of the
+// first release on a sample typed guide, like DpidRaw reads it, within the
+// tolerance of baseline_tolerance, and timed against it. The table lookup of lut=True is
+// compared against the exact C reference as well, and so is the approximate
+// pow of fast=True. Every output of the DpidSweep kernel is compared with the
+// single lambda kernel of the same instruction set, and its time with running
+// those kernels one after another. The histogram kernel of 8 and 10 bit
+// planes is compared with the kernel of the same instruction set, and its time
+// with it. The weight map of shared_weights and the kernels reading it are
+// compared with their C reference, and their time with the kernel of each
+// plane. The pre-reduction of hierarchical=True is compared with its C
+// reference, and its difference to the exact path is reported along with both
+// times. Throughput is given per source pixel.
+//
+// usage: dpid_bench [--check] [--width W] [--height H] [--min-time SECONDS]
+//
+//   --check     small planes, no timing; exits with 1 on a mismatch
+
+#include "dpid.h"
+#include "dpid_half.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+struct Options {
+    bool check = false;
+    int width = 1920;
+    int height = 1080;
+    double min_time = 0.25;
+};
+
+struct Plane {
+    const char *name;
+    int src_w, src_h, dst_w, dst_h;
+    float src_left;
+};
+
+static const char *optName(int opt) {
+    static const char *names[] = {"auto", "c", "sse4.1", "avx2", "avx512"};
+    return names[opt];
+}
+
+// smooth gradients with texture and noise, in [0, 1]
+static std::vector<float> makeImage(int width, int height, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+    std::vector<float> img(static_cast<size_t>(width) * height);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float v = 0.5f + 0.3f * std::sin(x * 0.05f) * std::cos(y * 0.031f);
+            if (((x / 7) ^ (y / 5)) & 1)
+                v += 0.15f;
+            img[static_cast<size_t>(y) * width + x] = std::clamp(v + noise(rng), 0.0f, 1.0f);
+        }
+    }
+
+    return img;
+}
+
+template<typename T>
+static std::vector<T> quantize(const std::vector<float> &img, int bits) {
+    std::vector<T> out(img.size());
+
+    for (size_t i = 0; i < img.size(); ++i) {
+        if constexpr (!std::is_integral_v<T>)
+            out[i] = static_cast<T>(img[i]);
+        else
+            out[i] = static_cast<T>(std::lround(img[i] * ((1 << bits) - 1)));
+    }
+
+    return out;
+}
+
+// internal guide of Dpid: bilinear downscale, then RemoveGrain(11)
+template<typename T>
+static void runGuide(const std::vector<T> &src, std::vector<float> &down, std::vector<float> &avg,
+    const Plane &p, const DpidGeometry &geometry, int opt, DpidScratch &scratch) {
+
+    const int avg_stride = dpidAvgStride(p.dst_w);
+
+    dpidGetResize(sizeof(T), !std::is_integral_v<T>, opt)(
+        src.data(), p.src_w, down.data(), avg_stride, geometry, 0, p.dst_h, scratch);
+    dpidGetBlur(sizeof(float), true, opt)(
+        down.data(), avg_stride, avg.data(), avg_stride, p.dst_w, p.dst_h, 0, p.dst_h, scratch);
+}
+
+template<typename T>
+static void runKernel(const std::vector<T> &src, std::vector<T> &dst, const std::vector<float> &avg,
+    const Plane &p, const DpidGeometry &geometry, float lambda, int lambda_class, const DpidLut *lut, int opt,
+    DpidScratch &scratch) {
+
+    dpidGetKernel(sizeof(T), !std::is_integral_v<T>, opt, lambda_class, geometry.aligned)(
+        src.data(), p.src_w, avg.data(), dpidAvgStride(p.dst_w), dst.data(), p.dst_w, geometry, lambda, lut, 0, p.dst_h, scratch);
+}
+
+template<typename T>
+static void runSweep(const std::vector<T> &src, std::vector<std::vector<T>> &dst, const std::vector<float> &avg,
+    const Plane &p, const DpidGeometry &geometry, const float *lambda, int num_lambda, bool fast, int opt,
+    DpidScratch &scratch) {
+
+    void *dstp[DPID_SWEEP_MAX];
+    for (int i = 0; i < num_lambda; ++i)
+        dstp[i] = dst[i].data();
+
+    dpidGetSweepKernel(sizeof(T), !std::is_integral_v<T>, opt, fast, geometry.aligned)(
+        src.data(), p.src_w, avg.data(), dpidAvgStride(p.dst_w), dstp, p.dst_w, geometry, lambda, num_lambda, 0, p.dst_h, scratch);
+}
+
+template<typename T>
+static void runHistogram(const std::vector<T> &src, std::vector<T> &dst, const std::vector<float> &avg,
+    const Plane &p, const DpidGeometry &geometry, float lambda, int lambda_class, int opt, DpidScratch &scratch) {
+
+    dpidGetHistogramKernel(sizeof(T), opt, lambda_class, geometry.aligned)(
+        src.data(), p.src_w, avg.data(), dpidAvgStride(p.dst_w), dst.data(), p.dst_w, geometry, lambda, nullptr, 0, p.dst_h, scratch);
+}
+
+// shared_weights on three planes: the weight map from the guide of the
+// first plane, then the kernel of every plane reading it
+template<typename T>
+static void runShared(const std::vector<T> *src, std::vector<T> *dst, const std::vector<float> *avg,
+    std::vector<float> &weights, const Plane &p, const DpidGeometry &geometry, float lambda, int lambda_class, int opt,
+    DpidScratch &scratch) {
+
+    const int avg_stride = dpidAvgStride(p.dst_w);
+    const int weight_stride = dpidAvgStride(geometry.x.src_size);
+    const DpidGuidePlane guide = {src[0].data(), p.src_w, avg[0].data(), 1.0f};
+
+    dpidGetWeights(sizeof(T), !std::is_integral_v<T>, opt, lambda_class)(
+        &guide, 1, avg_stride, geometry, lambda, nullptr, weights.data(), weight_stride, 0, p.dst_h, scratch);
+
+    for (int j = 0; j < 3; ++j)
+        dpidGetSharedKernel(sizeof(T), !std::is_integral_v<T>, opt, geometry.aligned)(
+            src[j].data(), p.src_w, avg[j].data(), avg_stride, weights.data(), weight_stride,
+            dst[j].data(), p.dst_w, geometry, 0, p.dst_h, scratch);
+}
+
+// hierarchical=True: pre-reduction by `factor`, then guide and kernel on the
+// reduced float plane like Dpid runs them
+template<typename T>
+static void runHierarchical(const std::vector<T> &src, std::vector<T> &dst, std::vector<float> &reduced,
+    std::vector<float> &down, std::vector<float> &avg, std::vector<float> &filtered,
+    const Plane &p, const DpidGeometry &geometry, int factor, float lambda, int lambda_class, int opt,
+    DpidScratch &scratch) {
+
+    const int reduced_stride = dpidAvgStride(geometry.x.src_size);
+    const int avg_stride = dpidAvgStride(p.dst_w);
+
+    dpidGetReduce(sizeof(T), !std::is_integral_v<T>, opt, lambda_class)(
+        src.data(), p.src_w, p.src_w, p.src_h, reduced.data(), reduced_stride, factor, lambda, nullptr, 0, geometry.y.src_size, scratch);
+    dpidGetResize(sizeof(float), true, opt)(
+        reduced.data(), reduced_stride, down.data(), avg_stride, geometry, 0, p.dst_h, scratch);
+    dpidGetBlur(sizeof(float), true, opt)(
+        down.data(), avg_stride, avg.data(), avg_stride, p.dst_w, p.dst_h, 0, p.dst_h, scratch);
+    dpidGetKernel(sizeof(float), true, opt, lambda_class, geometry.aligned)(
+        reduced.data(), reduced_stride, avg.data(), avg_stride, filtered.data(), avg_stride, geometry, lambda, nullptr, 0, p.dst_h, scratch);
+    dpidGetStore(sizeof(T), !std::is_integral_v<T>)(
+        filtered.data(), avg_stride, dst.data(), p.dst_w, p.dst_w, 0, p.dst_h);
+}
+
+// The per pixel algorithm of the first release, in which DpidRaw blurred
+// its sample typed guide clip for every output pixel and evaluated std::pow
+// and the coverage of every source pixel of the footprint. It is the baseline
+// the refactored passes are checked against, and is kept as it was.
+static float contribution(float f, float x, float y,
+    float sx, float ex, float sy, float ey) {
+
+    if (x < sx)
+        f *= 1.0f - (sx - x);
+
+    if ((x + 1.0f) > ex)
+        f *= ex - x;
+
+    if (y < sy)
+        f *= 1.0f - (sy - y);
+
+    if ((y + 1.0f) > ey)
+        f *= ey - y;
+
+    return f;
+}
+
+template<typename T>
+static void baselineProcess(const T * srcp, int src_stride,
+    const T * downp, int down_stride,
+    T * dstp, int dst_stride,
+    int src_w, int src_h, int dst_w, int dst_h, float lambda,
+    float src_left, float src_top, float src_width, float src_height) {
+
+    const float scale_x = src_width / dst_w;
+    const float scale_y = src_height / dst_h;
+
+    for (int outer_y = 0; outer_y < dst_h; ++outer_y) {
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+
+            // avg = RemoveGrain(down, 11)
+            float avg {};
+            for (int inner_y = -1; inner_y <= 1; ++inner_y) {
+                for (int inner_x = -1; inner_x <= 1; ++inner_x) {
+
+                    int y = std::clamp(outer_y + inner_y, 0, dst_h - 1);
+                    int x = std::clamp(outer_x + inner_x, 0, dst_w - 1);
+
+                    T pixel = downp[y * down_stride + x];
+                    avg += pixel * (2 - std::abs(inner_y)) * (2 - std::abs(inner_x));
+                }
+            }
+            avg /= 16.f;
+
+            // Dpid
+            const float sx = std::clamp(outer_x * scale_x + src_left, 0.f, static_cast<float>(src_w));
+            const float ex = std::clamp((outer_x + 1) * scale_x + src_left, 0.f, static_cast<float>(src_w));
+            const float sy = std::clamp(outer_y * scale_y + src_top, 0.f, static_cast<float>(src_h));
+            const float ey = std::clamp((outer_y + 1) * scale_y + src_top, 0.f, static_cast<float>(src_h));
+
+            const int sxr = static_cast<int>(std::floor(sx));
+            const int exr = static_cast<int>(std::ceil(ex));
+            const int syr = static_cast<int>(std::floor(sy));
+            const int eyr = static_cast<int>(std::ceil(ey));
+
+            float sum_pixel {};
+            float sum_weight {};
+
+            for (int inner_y = syr; inner_y < eyr; ++inner_y) {
+                for (int inner_x = sxr; inner_x < exr; ++inner_x) {
+                    T pixel = srcp[inner_y * src_stride + inner_x];
+                    float distance = std::abs(avg - static_cast<float>(pixel));
+                    float weight = std::pow(distance, lambda);
+                    weight = contribution(weight, static_cast<float>(inner_x), static_cast<float>(inner_y), sx, ex, sy, ey);
+
+                    sum_pixel += weight * pixel;
+                    sum_weight += weight;
+                }
+            }
+
+            dstp[outer_y * dst_stride + outer_x] = static_cast<T>((sum_weight == 0.f) ? avg : sum_pixel / sum_weight);
+        }
+    }
+}
+
+// DpidRaw with a sample typed guide clip: the blur pass, then the kernel
+template<typename T>
+static void runRaw(const std::vector<T> &src, const std::vector<T> &guide, std::vector<T> &dst, std::vector<float> &avg,
+    const Plane &p, const DpidGeometry &geometry, float lambda, int opt, DpidScratch &scratch) {
+
+    dpidGetBlur(sizeof(T), !std::is_integral_v<T>, opt)(
+        guide.data(), p.dst_w, avg.data(), dpidAvgStride(p.dst_w), p.dst_w, p.dst_h, 0, p.dst_h, scratch);
+    runKernel(src, dst, avg, p, geometry, lambda, dpidLambdaClass(lambda), nullptr, opt, scratch);
+}
+
+// best time of repeated runs in seconds
+template<typename F>
+static double measure(F &&f, double min_time) {
+    using clock = std::chrono::steady_clock;
+
+    double best = 1e30;
+    double total = 0.0;
+
+    for (int i = 0; i < 3 || total < min_time; ++i) {
+        const auto start = clock::now();
+        f();
+        const double t = std::chrono::duration<double>(clock::now() - start).count();
+        best = std::min(best, t);
+        total += t;
+    }
+
+    return best;
+}
+
+template<typename T>
+static int runFormat(const char *format, int bits, const Options &o) {
+    // half precision output may round to the neighbouring value, 2^-11 apart below 1
+    constexpr double tolerance = std::is_same_v<T, DpidHalf> ? 1.0 / 2048 : (std::is_floating_point_v<T> ? 1e-4 : 1.0);
+    // The passes add in a different order than the algorithm of the first
+    // release, the guide in two separable blur passes and the footprint with
+    // the coverage from tables, and the vectorized paths use a polynomial pow.
+    // On the test planes the output differs from it by at most 1 step of
+    // integer formats (8 and 10 bit opt=1 not at all), 1.5e-5 for float and
+    // 1 step of half.
+    constexpr double baseline_tolerance = std::is_same_v<T, DpidHalf> ? 1.0 / 2048 : (std::is_floating_point_v<T> ? 5e-5 : 1.0);
+    // documented accuracy of lut=True against the exact path
+    const double lut_tolerance = 3.0;
+
+    // 16x accumulates row by row from 1920 pixels wide sources on
+    const float scales[] = {2.0f, 2.5f, 4.0f, 8.0f, 16.0f, 32.0f, 64.0f};
+    const float lambdas[] = {0.0f, 0.5f, 1.0f, 2.0f, 1.5f};
+    const int cpu_level = dpidGetCpuLevel();
+
+    // reused like the filter reuses the scratch of its threads
+    DpidScratch scratch;
+    int failures = 0;
+
+    for (float scale : scales) {
+        const int dst_w = static_cast<int>(o.width / scale);
+        const int dst_h = static_cast<int>(o.height / scale);
+
+        // 4:2:0 with left chroma siting, as Dpid computes it for _ChromaLocation=0
+        const float h_scale = static_cast<float>(dst_w / 2) / (o.width / 2);
+        const float chroma_left = (0.5f * h_scale - 0.5f) / h_scale / 2.0f;
+
+        const Plane planes[] = {
+            {"luma", o.width, o.height, dst_w, dst_h, 0.0f},
+            {"chroma", o.width / 2, o.height / 2, dst_w / 2, dst_h / 2, chroma_left},
+        };
+
+        for (const Plane &p : planes) {
+            const DpidGeometry geometry = dpidMakeGeometry(p.src_w, p.src_h, p.dst_w, p.dst_h,
+                p.src_left, 0.0f, static_cast<float>(p.src_w), static_cast<float>(p.src_h), true);
+
+            const std::vector<T> src = quantize<T>(makeImage(p.src_w, p.src_h, p.src_w), bits);
+            const size_t dst_size = static_cast<size_t>(p.dst_w) * p.dst_h;
+            const size_t avg_size = static_cast<size_t>(dpidAvgStride(p.dst_w)) * p.dst_h;
+
+            std::vector<float> down(avg_size), avg(avg_size);
+            std::vector<T> ref(dst_size), dst(dst_size);
+
+            for (int opt = DPID_OPT_C; opt <= cpu_level && !o.check; ++opt) {
+                const double t = measure([&] { runGuide(src, down, avg, p, geometry, opt, scratch); }, o.min_time);
+                const double pixels = static_cast<double>(p.src_w) * p.src_h;
+
+                std::printf("%-5s %3.1fx %-6s guide          %-6s %9.3f ms %9.1f Mpix/s %7.2f ns/pix\n",
+                    format, scale, p.name, optName(opt), t * 1e3, pixels / t * 1e-6, t / pixels * 1e9);
+            }
+
+            for (float lambda : lambdas) {
+                runGuide(src, down, avg, p, geometry, DPID_OPT_C, scratch);
+                runKernel(src, ref, avg, p, geometry, lambda, dpidLambdaClass(lambda), nullptr, DPID_OPT_C, scratch);
+
+                DpidLut table;
+                const bool has_lut = dpidMakeLut(table, bits, !std::is_integral_v<T>, lambda);
+                const bool has_fast = dpidLambdaClass(lambda) == DPID_LAMBDA_ANY;
+
+                // exact, lut=True and fast=True
+                for (int mode = 0; mode < 3; ++mode) {
+                    if ((mode == 1 && !has_lut) || (mode == 2 && !has_fast))
+                        continue;
+
+                    const bool use_lut = mode == 1;
+                    const DpidLut *lut = use_lut ? &table : nullptr;
+                    const int lambda_class = use_lut ? table.lambda_class : (mode == 2 ? DPID_LAMBDA_FAST : dpidLambdaClass(lambda));
+                    const char *variant = use_lut ? "lut" : (mode == 2 ? "fast" : "");
+
+                    for (int opt = DPID_OPT_C; opt <= cpu_level; ++opt) {
+                        runGuide(src, down, avg, p, geometry, opt, scratch);
+                        runKernel(src, dst, avg, p, geometry, lambda, lambda_class, lut, opt, scratch);
+
+                        double max_diff = 0.0;
+                        for (size_t i = 0; i < dst_size; ++i)
+                            max_diff = std::max(max_diff, std::abs(static_cast<double>(dst[i]) - ref[i]));
+
+                        const bool ok = max_diff <= (use_lut ? lut_tolerance : tolerance);
+                        if (!ok)
+                            ++failures;
+
+                        if (o.check) {
+                            if (!ok)
+                                std::printf("FAIL %-5s %3.1fx %-6s lambda=%-3g %-4s %-6s max diff %g\n",
+                                    format, scale, p.name, lambda, variant, optName(opt), max_diff);
+                            continue;
+                        }
+
+                        const double t = measure([&] { runKernel(src, dst, avg, p, geometry, lambda, lambda_class, lut, opt, scratch); }, o.min_time);
+                        const double pixels = static_cast<double>(p.src_w) * p.src_h;
+
+                        std::printf("%-5s %3.1fx %-6s lambda=%-3g %-4s %-6s %9.3f ms %9.1f Mpix/s %7.2f ns/pix  max diff %g%s\n",
+                            format, scale, p.name, lambda, variant, optName(opt),
+                            t * 1e3, pixels / t * 1e-6, t / pixels * 1e9, max_diff, ok ? "" : "  FAIL");
+                    }
+                }
+            }
+
+            // every path against the algorithm of the first release, on the
+            // bilinear guide stored in the sample type like a DpidRaw clip2
+            std::vector<T> guide(dst_size), base(dst_size);
+            runGuide(src, down, avg, p, geometry, DPID_OPT_C, scratch);
+            dpidGetStore(sizeof(T), !std::is_integral_v<T>)(down.data(), dpidAvgStride(p.dst_w), guide.data(), p.dst_w, p.dst_w, 0, p.dst_h);
+
+            for (float lambda : lambdas) {
+                baselineProcess(src.data(), p.src_w, guide.data(), p.dst_w, base.data(), p.dst_w,
+                    p.src_w, p.src_h, p.dst_w, p.dst_h, lambda, p.src_left, 0.0f, static_cast<float>(p.src_w), static_cast<float>(p.src_h));
+
+                for (int opt = DPID_OPT_C; opt <= cpu_level; ++opt) {
+                    runRaw(src, guide, dst, avg, p, geometry, lambda, opt, scratch);
+
+                    double max_diff = 0.0;
+                    for (size_t i = 0; i < dst_size; ++i)
+                        max_diff = std::max(max_diff, std::abs(static_cast<double>(dst[i]) - base[i]));
+
+                    const bool ok = max_diff <= baseline_tolerance;
+                    if (!ok)
+                        ++failures;
+
+                    if (o.check) {
+                        if (!ok)
+                            std::printf("FAIL %-5s %3.1fx %-6s lambda=%-3g base %-6s max diff %g\n",
+                                format, scale, p.name, lambda, optName(opt), max_diff);
+                        continue;
+                    }
+
+                    const double t = measure([&] { runRaw(src, guide, dst, avg, p, geometry, lambda, opt, scratch); }, o.min_time);
+                    const double t_base = measure([&] {
+                        baselineProcess(src.data(), p.src_w, guide.data(), p.dst_w, base.data(), p.dst_w,
+                            p.src_w, p.src_h, p.dst_w, p.dst_h, lambda, p.src_left, 0.0f, static_cast<float>(p.src_w), static_cast<float>(p.src_h));
+                    }, o.min_time);
+                    const double pixels = static_cast<double>(p.src_w) * p.src_h;
+
+                    std::printf("%-5s %3.1fx %-6s lambda=%-3g base %-6s %9.3f ms %9.1f Mpix/s %7.2f ns/pix  baseline %9.3f ms  max diff %g%s\n",
+                        format, scale, p.name, lambda, optName(opt),
+                        t * 1e3, pixels / t * 1e-6, t / pixels * 1e9, t_base * 1e3, max_diff, ok ? "" : "  FAIL");
+                }
+            }
+
+            // DpidSweep over all lambda values, exact and fast=True
+            const int num_lambda = static_cast<int>(std::size(lambdas));
+            std::vector<std::vector<T>> sweep(num_lambda, std::vector<T>(dst_size));
+
+            for (bool fast : {false, true}) {
+                for (int opt = DPID_OPT_C; opt <= cpu_level; ++opt) {
+                    runGuide(src, down, avg, p, geometry, opt, scratch);
+                    runSweep(src, sweep, avg, p, geometry, lambdas, num_lambda, fast, opt, scratch);
+
+                    double max_diff = 0.0;
+                    for (int j = 0; j < num_lambda; ++j) {
+                        const int lambda_class = fast && dpidLambdaClass(lambdas[j]) == DPID_LAMBDA_ANY ? DPID_LAMBDA_FAST : dpidLambdaClass(lambdas[j]);
+                        runKernel(src, ref, avg, p, geometry, lambdas[j], lambda_class, nullptr, opt, scratch);
+
+                        for (size_t i = 0; i < dst_size; ++i)
+                            max_diff = std::max(max_diff, std::abs(static_cast<double>(sweep[j][i]) - ref[i]));
+                    }
+
+                    // equal but for multiply-adds the compiler fuses differently
+                    const bool ok = max_diff <= tolerance;
+                    if (!ok)
+                        ++failures;
+
+                    if (o.check) {
+                        if (!ok)
+                            std::printf("FAIL %-5s %3.1fx %-6s sweep%d %-4s %-6s max diff %g\n",
+                                format, scale, p.name, num_lambda, fast ? "fast" : "", optName(opt), max_diff);
+                        continue;
+                    }
+
+                    const double t = measure([&] { runSweep(src, sweep, avg, p, geometry, lambdas, num_lambda, fast, opt, scratch); }, o.min_time);
+                    const double t_single = measure([&] {
+                        for (int j = 0; j < num_lambda; ++j) {
+                            const int lambda_class = fast && dpidLambdaClass(lambdas[j]) == DPID_LAMBDA_ANY ? DPID_LAMBDA_FAST : dpidLambdaClass(lambdas[j]);
+                            runKernel(src, sweep[j], avg, p, geometry, lambdas[j], lambda_class, nullptr, opt, scratch);
+                        }
+                    }, o.min_time);
+                    const double pixels = static_cast<double>(p.src_w) * p.src_h;
+
+                    std::printf("%-5s %3.1fx %-6s sweep%-5d %-4s %-6s %9.3f ms %9.1f Mpix/s %7.2f ns/pix  separately %9.3f ms  max diff %g%s\n",
+                        format, scale, p.name, num_lambda, fast ? "fast" : "", optName(opt),
+                        t * 1e3, pixels / t * 1e-6, t / pixels * 1e9, t_single * 1e3, max_diff, ok ? "" : "  FAIL");
+                }
+            }
+
+            // shared_weights on three planes of this size, against its C
+            // reference, and its time against the kernel of each plane
+            {
+                const std::vector<T> shared_src[3] = {src, quantize<T>(makeImage(p.src_w, p.src_h, p.src_w + 1), bits),
+                    quantize<T>(makeImage(p.src_w, p.src_h, p.src_w + 2), bits)};
+                std::vector<float> shared_avg[3];
+                std::vector<T> shared_dst[3], shared_ref[3];
+                std::vector<float> weights(static_cast<size_t>(dpidAvgStride(geometry.x.src_size)) * geometry.y.src_size);
+
+                for (int j = 0; j < 3; ++j) {
+                    shared_avg[j].resize(avg_size);
+                    shared_dst[j].resize(dst_size);
+                    shared_ref[j].resize(dst_size);
+                    runGuide(shared_src[j], down, shared_avg[j], p, geometry, DPID_OPT_C, scratch);
+                }
+
+                for (float lambda : lambdas) {
+                    const int lambda_class = dpidLambdaClass(lambda);
+
+                    runShared(shared_src, shared_ref, shared_avg, weights, p, geometry, lambda, lambda_class, DPID_OPT_C, scratch);
+
+                    for (int opt = DPID_OPT_C; opt <= cpu_level; ++opt) {
+                        runShared(shared_src, shared_dst, shared_avg, weights, p, geometry, lambda, lambda_class, opt, scratch);
+
+                        double max_diff = 0.0;
+                        for (int j = 0; j < 3; ++j)
+                            for (size_t i = 0; i < dst_size; ++i)
+                                max_diff = std::max(max_diff, std::abs(static_cast<double>(shared_dst[j][i]) - shared_ref[j][i]));
+
+                        const bool ok = max_diff <= tolerance;
+                        if (!ok)
+                            ++failures;
+
+                        if (o.check) {
+                            if (!ok)
+                                std::printf("FAIL %-5s %3.1fx %-6s lambda=%-3g shared3 %-6s max diff %g\n",
+                                    format, scale, p.name, lambda, optName(opt), max_diff);
+                            continue;
+                        }
+
+                        const double t = measure([&] { runShared(shared_src, shared_dst, shared_avg, weights, p, geometry, lambda, lambda_class, opt, scratch); }, o.min_time);
+                        const double t_single = measure([&] {
+                            for (int j = 0; j < 3; ++j)
+                                runKernel(shared_src[j], shared_dst[j], shared_avg[j], p, geometry, lambda, lambda_class, nullptr, opt, scratch);
+                        }, o.min_time);
+                        const double pixels = 3.0 * p.src_w * p.src_h;
+
+                        std::printf("%-5s %3.1fx %-6s lambda=%-3g shared3 %-6s %9.3f ms %9.1f Mpix/s %7.2f ns/pix  separately %9.3f ms  max diff %g%s\n",
+                            format, scale, p.name, lambda, optName(opt),
+                            t * 1e3, pixels / t * 1e-6, t / pixels * 1e9, t_single * 1e3, max_diff, ok ? "" : "  FAIL");
+                    }
+                }
+            }
+
+            // the histogram kernel of 8 and 10 bit planes for the lambda values
+            // with pow, exact and fast=True, against the kernel of each
+            for (float lambda : lambdas) {
+                if (!std::is_integral_v<T> || bits > 10 || dpidLambdaClass(lambda) != DPID_LAMBDA_ANY)
+                    continue;
+
+                runGuide(src, down, avg, p, geometry, DPID_OPT_C, scratch);
+
+                for (bool fast : {false, true}) {
+                    const int lambda_class = fast ? DPID_LAMBDA_FAST : DPID_LAMBDA_ANY;
+
+                    for (int opt = DPID_OPT_C; opt <= cpu_level; ++opt) {
+                        runHistogram(src, dst, avg, p, geometry, lambda, lambda_class, opt, scratch);
+                        runKernel(src, ref, avg, p, geometry, lambda, lambda_class, nullptr, opt, scratch);
+
+                        double max_diff = 0.0;
+                        for (size_t i = 0; i < dst_size; ++i)
+                            max_diff = std::max(max_diff, std::abs(static_cast<double>(dst[i]) - ref[i]));
+
+                        // equal but for the order of the additions
+                        const bool ok = max_diff <= tolerance;
+                        if (!ok)
+                            ++failures;
+
+                        if (o.check) {
+                            if (!ok)
+                                std::printf("FAIL %-5s %3.1fx %-6s lambda=%-3g hist %-4s %-6s max diff %g\n",
+                                    format, scale, p.name, lambda, fast ? "fast" : "", optName(opt), max_diff);
+                            continue;
+                        }
+
+                        const double t = measure([&] { runHistogram(src, dst, avg, p, geometry, lambda, lambda_class, opt, scratch); }, o.min_time);
+                        const double t_kernel = measure([&] { runKernel(src, ref, avg, p, geometry, lambda, lambda_class, nullptr, opt, scratch); }, o.min_time);
+                        const double pixels = static_cast<double>(p.src_w) * p.src_h;
+
+                        std::printf("%-5s %3.1fx %-6s lambda=%-3g hist %-4s %-6s %9.3f ms %9.1f Mpix/s %7.2f ns/pix  kernel %9.3f ms  max diff %g%s\n",
+                            format, scale, p.name, lambda, fast ? "fast" : "", optName(opt),
+                            t * 1e3, pixels / t * 1e-6, t / pixels * 1e9, t_kernel * 1e3, max_diff, ok ? "" : "  FAIL");
+                    }
+                }
+            }
+
+            // hierarchical=True; the difference to the exact path is in steps
+            // of the output format
+            const int factor = dpidReduceFactor(scale);
+            if (factor < 2)
+                continue;
+
+            const DpidGeometry reduced_geometry = dpidMakeGeometry(
+                dpidReducedSize(p.src_w, factor), dpidReducedSize(p.src_h, factor), p.dst_w, p.dst_h,
+                p.src_left / factor, 0.0f, static_cast<float>(p.src_w) / factor, static_cast<float>(p.src_h) / factor, true);
+
+            std::vector<float> reduced(static_cast<size_t>(dpidAvgStride(reduced_geometry.x.src_size)) * reduced_geometry.y.src_size);
+            std::vector<float> filtered(avg_size);
+            std::vector<T> exact(dst_size);
+
+            for (float lambda : lambdas) {
+                const int lambda_class = dpidLambdaClass(lambda);
+
+                runHierarchical(src, ref, reduced, down, avg, filtered, p, reduced_geometry, factor, lambda, lambda_class, DPID_OPT_C, scratch);
+                runGuide(src, down, avg, p, geometry, DPID_OPT_C, scratch);
+                runKernel(src, exact, avg, p, geometry, lambda, lambda_class, nullptr, DPID_OPT_C, scratch);
+
+                double exact_max = 0.0, exact_sum = 0.0, exact_sq = 0.0;
+                for (size_t i = 0; i < dst_size; ++i) {
+                    const double diff = std::abs(static_cast<double>(ref[i]) - exact[i]);
+                    exact_max = std::max(exact_max, diff);
+                    exact_sum += diff;
+                    exact_sq += diff * diff;
+                }
+
+                const double peak = std::is_integral_v<T> ? (1 << bits) - 1 : 1.0;
+                const double psnr = exact_sq > 0.0 ? 10.0 * std::log10(peak * peak * dst_size / exact_sq) : INFINITY;
+
+                for (int opt = DPID_OPT_C; opt <= cpu_level; ++opt) {
+                    runHierarchical(src, dst, reduced, down, avg, filtered, p, reduced_geometry, factor, lambda, lambda_class, opt, scratch);
+
+                    double max_diff = 0.0;
+                    for (size_t i = 0; i < dst_size; ++i)
+                        max_diff = std::max(max_diff, std::abs(static_cast<double>(dst[i]) - ref[i]));
+
+                    const bool ok = max_diff <= tolerance;
+                    if (!ok)
+                        ++failures;
+
+                    if (o.check) {
+                        if (!ok)
+                            std::printf("FAIL %-5s %3.1fx %-6s lambda=%-3g reduce%d %-6s max diff %g\n",
+                                format, scale, p.name, lambda, factor, optName(opt), max_diff);
+                        continue;
+                    }
+
+                    const double t = measure([&] {
+                        runHierarchical(src, dst, reduced, down, avg, filtered, p, reduced_geometry, factor, lambda, lambda_class, opt, scratch);
+                    }, o.min_time);
+                    const double t_exact = measure([&] {
+                        runGuide(src, down, avg, p, geometry, opt, scratch);
+                        runKernel(src, exact, avg, p, geometry, lambda, lambda_class, nullptr, opt, scratch);
+                    }, o.min_time);
+                    const double pixels = static_cast<double>(p.src_w) * p.src_h;
+
+                    std::printf("%-5s %3.1fx %-6s lambda=%-3g reduce%d %-6s %9.3f ms %9.1f Mpix/s %7.2f ns/pix  exact %9.3f ms  "
+                        "vs exact max %g mean %.3f psnr %.1f dB  max diff %g%s\n",
+                        format, scale, p.name, lambda, factor, optName(opt),
+                        t * 1e3, pixels / t * 1e-6, t / pixels * 1e9, t_exact * 1e3,
+                        exact_max, exact_sum / dst_size, psnr, max_diff, ok ? "" : "  FAIL");
+                }
+            }
+        }
+    }
+
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    Options o;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        if (arg == "--check") {
+            o.check = true;
+            o.width = 320;
+            o.height = 180;
+        } else if (arg == "--width" && i + 1 < argc) {
+            o.width = std::atoi(argv[++i]);
+        } else if (arg == "--height" && i + 1 < argc) {
+            o.height = std::atoi(argv[++i]);
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            o.min_time = std::atof(argv[++i]);
+        } else {
+            std::fprintf(stderr, "usage: %s [--check] [--width W] [--height H] [--min-time SECONDS]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (o.width < 16 || o.height < 16) {
+        std::fprintf(stderr, "the planes must be at least 16x16\n");
+        return 2;
+    }
+
+    std::printf("%dx%d source, best of repeated runs, highest instruction set: %s\n",
+        o.width, o.height, optName(dpidGetCpuLevel()));
+
+    int failures = 0;
+    failures += runFormat<uint8_t>("8bit", 8, o);
+    failures += runFormat<uint16_t>("10bit", 10, o);
+    failures += runFormat<uint16_t>("16bit", 16, o);
+    failures += runFormat<DpidHalf>("half", 16, o);
+    failures += runFormat<float>("float", 32, o);
+
+    std::printf("%d mismatches against the references\n", failures);
+    return failures ? 1 : 0;
+}
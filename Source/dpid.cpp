@@ -0,0 +1,1047 @@
+#include "VapourSynth4.h"
+#include "dpid.h"
+#include "dpid_blur.h"
+#include "dpid_half.h"
+#include "dpid_resize.h"
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#ifdef DPID_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+static DpidAxis makeAxis(int src_size, int dst_size, float src_offset, float src_extent) {
+    DpidAxis axis;
+    axis.src_size = src_size;
+    axis.dst_size = dst_size;
+
+    // room for one vector of the widest instruction set past the end
+    const size_t padded = static_cast<size_t>(dst_size) + 16;
+    axis.begin.assign(padded, 0);
+    axis.end.assign(padded, 0);
+    axis.first.assign(padded, 1.0f);
+    axis.last.assign(padded, 1.0f);
+
+    const float scale = src_extent / dst_size;
+
+    for (int i = 0; i < dst_size; ++i) {
+        const float s = std::clamp(i * scale + src_offset, 0.f, static_cast<float>(src_size));
+        const float e = std::clamp((i + 1) * scale + src_offset, 0.f, static_cast<float>(src_size));
+
+        const int sr = static_cast<int>(std::floor(s));
+        const int er = static_cast<int>(std::ceil(e));
+
+        axis.begin[i] = sr;
+        axis.end[i] = er;
+
+        if (sr < er) {
+            const float first = static_cast<float>(sr);
+            const float last = static_cast<float>(er - 1);
+
+            if (first < s)
+                axis.first[i] *= 1.0f - (s - first);
+            if (first + 1.0f > e)
+                axis.first[i] *= e - first;
+
+            if (er - 1 != sr) {
+                if (last + 1.0f > e)
+                    axis.last[i] *= e - last;
+            }
+        }
+    }
+
+    // the first footprint wins ties
+    std::vector<float> coverage(src_size, 0.0f);
+    axis.owner.assign(static_cast<size_t>(src_size) + 16, -1);
+
+    for (int i = 0; i < dst_size; ++i) {
+        for (int pos = axis.begin[i]; pos < axis.end[i]; ++pos) {
+            const float c = dpidCoverage(axis, i, pos);
+
+            if (c > coverage[pos]) {
+                coverage[pos] = c;
+                axis.owner[pos] = i;
+            }
+        }
+    }
+
+    // Pixels outside the footprints go to the nearest one. The running
+    // maximum also keeps the table from decreasing where footprints overlap
+    // by more than one pixel.
+    int owner = 0;
+    for (int pos = 0; pos < src_size; ++pos) {
+        if (axis.owner[pos] >= 0) {
+            owner = axis.owner[pos];
+            break;
+        }
+    }
+
+    for (int pos = 0; pos < src_size; ++pos) {
+        owner = std::max(owner, axis.owner[pos]);
+        axis.owner[pos] = owner;
+    }
+
+    std::fill(axis.owner.begin() + src_size, axis.owner.end(), owner);
+
+    return axis;
+}
+
+static bool isAligned(const DpidAxis &axis) noexcept {
+    for (int i = 0; i < axis.dst_size; ++i)
+        if (axis.first[i] != 1.0f || axis.last[i] != 1.0f)
+            return false;
+
+    return true;
+}
+
+// Same sampling positions and mirroring as zimg's bilinear filter: the
+// triangle is stretched by the scaling factor when downscaling.
+static DpidFilter makeBilinear(int src_size, int dst_size, double shift, double width) {
+    const double scale = dst_size / width;
+    const double step = std::min(scale, 1.0);
+    const int filter_size = std::max(static_cast<int>(std::ceil(1.0 / step)) * 2, 1);
+
+    // taps of every output pixel before merging the mirrored positions
+    std::vector<int> index(static_cast<size_t>(dst_size) * filter_size);
+    std::vector<double> weight(static_cast<size_t>(dst_size) * filter_size);
+
+    DpidFilter filter;
+    filter.taps = 1;
+    filter.left.resize(dst_size);
+
+    for (int i = 0; i < dst_size; ++i) {
+        const double pos = (i + 0.5) / scale + shift;
+        const double begin_pos = std::floor(pos - filter_size / 2.0 + 0.5) + 0.5;
+
+        double total = 0.0;
+        for (int j = 0; j < filter_size; ++j)
+            total += std::max(1.0 - std::abs((begin_pos + j - pos) * step), 0.0);
+
+        int lo = src_size - 1;
+        int hi = 0;
+
+        for (int j = 0; j < filter_size; ++j) {
+            const double xpos = begin_pos + j;
+            double real_pos;
+
+            if (xpos < 0.0)
+                real_pos = -xpos;
+            else if (xpos >= src_size)
+                real_pos = std::min(2.0 * src_size - xpos, src_size - 0.5);
+            else
+                real_pos = xpos;
+
+            const int idx = std::clamp(static_cast<int>(std::floor(real_pos)), 0, src_size - 1);
+            index[static_cast<size_t>(i) * filter_size + j] = idx;
+            weight[static_cast<size_t>(i) * filter_size + j] = std::max(1.0 - std::abs((xpos - pos) * step), 0.0) / total;
+            lo = std::min(lo, idx);
+            hi = std::max(hi, idx);
+        }
+
+        filter.left[i] = lo;
+        filter.taps = std::max(filter.taps, hi - lo + 1);
+    }
+
+    filter.coeffs.assign(static_cast<size_t>(dst_size) * filter.taps, 0.0f);
+
+    for (int i = 0; i < dst_size; ++i) {
+        filter.left[i] = std::min(filter.left[i], src_size - filter.taps);
+
+        for (int j = 0; j < filter_size; ++j) {
+            const size_t k = static_cast<size_t>(i) * filter_size + j;
+            filter.coeffs[static_cast<size_t>(i) * filter.taps + index[k] - filter.left[i]] += static_cast<float>(weight[k]);
+        }
+    }
+
+    return filter;
+}
+
+DpidGeometry dpidMakeGeometry(int src_w, int src_h, int dst_w, int dst_h,
+    float src_left, float src_top, float src_width, float src_height, bool guide) {
+
+    DpidGeometry geometry;
+    geometry.x = makeAxis(src_w, dst_w, src_left, src_width);
+    geometry.y = makeAxis(src_h, dst_h, src_top, src_height);
+    geometry.aligned = isAligned(geometry.x) && isAligned(geometry.y);
+
+    if (guide) {
+        geometry.guide_x = makeBilinear(src_w, dst_w, src_left, src_width);
+        geometry.guide_y = makeBilinear(src_h, dst_h, src_top, src_height);
+    }
+
+    return geometry;
+}
+
+DpidScratch::~DpidScratch() {
+    for (void *buffer : buffers)
+        ::operator delete(buffer, std::align_val_t{64});
+}
+
+void *DpidScratch::getBytes(int slot, size_t bytes) {
+    if (bytes > sizes[slot]) {
+        ::operator delete(buffers[slot], std::align_val_t{64});
+        buffers[slot] = nullptr;
+        sizes[slot] = 0;
+
+        buffers[slot] = ::operator new(bytes, std::align_val_t{64});
+        sizes[slot] = bytes;
+    }
+
+    return buffers[slot];
+}
+
+bool dpidMakeLut(DpidLut &lut, int bits_per_sample, bool is_float, float lambda) {
+    // small lambda puts most of the weight on distances close to 0, where
+    // rounding avg to a table entry changes the result noticeably
+    if (is_float || lambda < 0.5f || dpidLambdaClass(lambda) != DPID_LAMBDA_ANY)
+        return false;
+
+    const int max_value = (1 << bits_per_sample) - 1;
+    int size;
+
+    if (bits_per_sample <= 12) {
+        lut.scale = 16.0f;
+        lut.lambda_class = DPID_LAMBDA_LUT;
+        // a few spare entries for guides that overshoot by rounding
+        size = max_value * 16 + 17;
+    } else {
+        // interpolation is too coarse where pow is steep close to 0
+        if (lambda < 1.0f)
+            return false;
+
+        lut.scale = static_cast<float>(1 << 12) / (1 << bits_per_sample);
+        lut.lambda_class = DPID_LAMBDA_LUT_LERP;
+        size = static_cast<int>(max_value * lut.scale) + 3;
+    }
+
+    lut.table.resize(size);
+    for (int i = 0; i < size; ++i)
+        lut.table[i] = static_cast<float>(std::pow(i / static_cast<double>(lut.scale), static_cast<double>(lambda)));
+
+    return true;
+}
+
+template<int Lambda>
+static inline float rangeKernel(float distance, float lambda, float pow0) {
+    if constexpr (Lambda == DPID_LAMBDA_0)
+        return 1.0f;
+    else if constexpr (Lambda == DPID_LAMBDA_0_5)
+        return std::sqrt(distance);
+    else if constexpr (Lambda == DPID_LAMBDA_1)
+        return distance;
+    else if constexpr (Lambda == DPID_LAMBDA_2)
+        return distance * distance;
+    else if constexpr (Lambda == DPID_LAMBDA_FAST)
+        return dpidFastPow(distance, lambda, pow0);
+    else
+        return std::pow(distance, lambda);
+}
+
+// weight of `pixel` against the guide value `avg`; `avg_q` is avg in 1/16
+// steps for DPID_LAMBDA_LUT. Table positions are clamped to the last valid
+// index like in the vectorized kernels, so that samples above the declared
+// bit depth give the same weight there and here instead of reading past the
+// table.
+template<typename T, int Lambda>
+static inline float pixelWeight(float avg, int avg_q, T pixel, float lambda, float pow0, const DpidLut *lut) {
+    const float distance = std::abs(avg - static_cast<float>(pixel));
+
+    if constexpr (Lambda == DPID_LAMBDA_LUT) {
+        const int table_max = static_cast<int>(lut->table.size()) - 2;
+        return lut->table[std::min(std::abs(avg_q - static_cast<int>(pixel) * 16), table_max)];
+    } else if constexpr (Lambda == DPID_LAMBDA_LUT_LERP) {
+        const float pos = std::min(distance * lut->scale, static_cast<float>(lut->table.size() - 2));
+        const int i = static_cast<int>(pos);
+        return lut->table[i] + (pos - i) * (lut->table[i + 1] - lut->table[i]);
+    } else {
+        return rangeKernel<Lambda>(distance, lambda, pow0);
+    }
+}
+
+template<typename T, int Lambda, bool Aligned>
+static void dpidProcess(const T * VS_RESTRICT srcp, int src_stride,
+    const float * VS_RESTRICT avgp, int avg_stride,
+    T * VS_RESTRICT dstp, int dst_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut, int y_begin, int y_end) {
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int dst_w = gx.dst_size;
+    const float pow0 = std::pow(0.0f, lambda);
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+        const int syr = gy.begin[outer_y];
+        const int eyr = gy.end[outer_y];
+
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+
+            // avg = RemoveGrain(down, 11)
+            const float avg = avgp[outer_y * avg_stride + outer_x];
+            [[maybe_unused]] const int avg_q = static_cast<int>(avg * 16.0f + 0.5f);
+
+            // Dpid
+            const int sxr = gx.begin[outer_x];
+            const int exr = gx.end[outer_x];
+
+            float sum_pixel {};
+            float sum_weight {};
+
+            for (int inner_y = syr; inner_y < eyr; ++inner_y) {
+                const float coverage_y = Aligned ? 1.0f : dpidCoverage(gy, outer_y, inner_y);
+
+                for (int inner_x = sxr; inner_x < exr; ++inner_x) {
+                    T pixel = srcp[inner_y * src_stride + inner_x];
+                    float weight = pixelWeight<T, Lambda>(avg, avg_q, pixel, lambda, pow0, lut);
+                    if constexpr (!Aligned)
+                        weight *= dpidCoverage(gx, outer_x, inner_x) * coverage_y;
+
+                    sum_pixel += weight * pixel;
+                    sum_weight += weight;
+                }
+            }
+
+            dstp[outer_y * dst_stride + outer_x] = static_cast<T>((sum_weight == 0.f) ? avg : sum_pixel / sum_weight);
+        }
+    }
+}
+
+template<typename T, int Lambda, bool Aligned>
+static void dpidProcessC(const void *srcp, int src_stride,
+    const float *avgp, int avg_stride,
+    void *dstp, int dst_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch) {
+
+    dpidProcess<T, Lambda, Aligned>(
+        static_cast<const T *>(srcp), src_stride,
+        avgp, avg_stride,
+        static_cast<T *>(dstp), dst_stride,
+        geometry, lambda, lut, y_begin, y_end);
+}
+
+// dpidProcess through the histogram of each footprint, see
+// dpidGetHistogramKernel
+template<typename T, int Lambda, bool Aligned>
+static void dpidProcessHistogram(const void *srcp_, int src_stride,
+    const float *avgp, int avg_stride,
+    void *dstp_, int dst_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch) {
+
+    const T * srcp = static_cast<const T *>(srcp_);
+    T * dstp = static_cast<T *>(dstp_);
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int dst_w = gx.dst_size;
+    const float pow0 = std::pow(0.0f, lambda);
+
+    int max_cols = 0;
+    for (int i = 0; i < dst_w; ++i)
+        max_cols = std::max(max_cols, gx.end[i] - gx.begin[i]);
+
+    int max_rows = 0;
+    for (int i = y_begin; i < y_end; ++i)
+        max_rows = std::max(max_rows, gy.end[i] - gy.begin[i]);
+
+    // every output pixel sets the coverage it added back to zero
+    constexpr size_t num_values = size_t{1} << (8 * sizeof(T));
+    float * hist = scratch.get<float>(DPID_SCRATCH_HISTOGRAM, num_values);
+    int * bins = scratch.get<int>(DPID_SCRATCH_ROWS, static_cast<size_t>(max_cols) * max_rows);
+    std::fill(hist, hist + num_values, 0.0f);
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+            const float avg = avgp[outer_y * avg_stride + outer_x];
+            const int num_bins = dpidFillHistogram<T, Aligned>(srcp, src_stride, geometry, outer_x, outer_y, hist, bins);
+
+            float sum_pixel {};
+            float sum_weight {};
+
+            for (int i = 0; i < num_bins; ++i) {
+                const int value = bins[i];
+                const float weight = pixelWeight<T, Lambda>(avg, 0, static_cast<T>(value), lambda, pow0, lut) * hist[value];
+
+                sum_pixel += weight * value;
+                sum_weight += weight;
+                hist[value] = 0.0f;
+            }
+
+            dstp[outer_y * dst_stride + outer_x] = static_cast<T>((sum_weight == 0.f) ? avg : sum_pixel / sum_weight);
+        }
+    }
+}
+
+// range kernel of DpidSweepKernel for a lambda value of class `lambda_class`
+template<bool Fast>
+static inline float sweepKernel(int lambda_class, float distance, float lambda, float pow0) {
+    switch (lambda_class) {
+    case DPID_LAMBDA_0:
+        return rangeKernel<DPID_LAMBDA_0>(distance, lambda, pow0);
+    case DPID_LAMBDA_0_5:
+        return rangeKernel<DPID_LAMBDA_0_5>(distance, lambda, pow0);
+    case DPID_LAMBDA_1:
+        return rangeKernel<DPID_LAMBDA_1>(distance, lambda, pow0);
+    case DPID_LAMBDA_2:
+        return rangeKernel<DPID_LAMBDA_2>(distance, lambda, pow0);
+    default:
+        return rangeKernel<Fast ? DPID_LAMBDA_FAST : DPID_LAMBDA_ANY>(distance, lambda, pow0);
+    }
+}
+
+// dpidProcess for several lambda values; the weights of each value are
+// computed and accumulated in the same order as there
+template<typename T, bool Aligned, bool Fast>
+static void dpidProcessSweep(const T * VS_RESTRICT srcp, int src_stride,
+    const float * VS_RESTRICT avgp, int avg_stride,
+    T * const * dstp, int dst_stride,
+    const DpidGeometry &geometry, const float *lambda, int num_lambda, int y_begin, int y_end) {
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int dst_w = gx.dst_size;
+
+    int lambda_class[DPID_SWEEP_MAX];
+    float pow0[DPID_SWEEP_MAX];
+
+    for (int i = 0; i < num_lambda; ++i) {
+        lambda_class[i] = dpidLambdaClass(lambda[i]);
+        pow0[i] = std::pow(0.0f, lambda[i]);
+    }
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+        const int syr = gy.begin[outer_y];
+        const int eyr = gy.end[outer_y];
+
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+            const float avg = avgp[outer_y * avg_stride + outer_x];
+
+            const int sxr = gx.begin[outer_x];
+            const int exr = gx.end[outer_x];
+
+            float sum_pixel[DPID_SWEEP_MAX] {};
+            float sum_weight[DPID_SWEEP_MAX] {};
+
+            for (int inner_y = syr; inner_y < eyr; ++inner_y) {
+                const float coverage_y = Aligned ? 1.0f : dpidCoverage(gy, outer_y, inner_y);
+
+                for (int inner_x = sxr; inner_x < exr; ++inner_x) {
+                    T pixel = srcp[inner_y * src_stride + inner_x];
+                    float distance = std::abs(avg - static_cast<float>(pixel));
+                    [[maybe_unused]] float coverage = 1.0f;
+                    if constexpr (!Aligned)
+                        coverage = dpidCoverage(gx, outer_x, inner_x) * coverage_y;
+
+                    for (int i = 0; i < num_lambda; ++i) {
+                        float weight = sweepKernel<Fast>(lambda_class[i], distance, lambda[i], pow0[i]);
+                        if constexpr (!Aligned)
+                            weight *= coverage;
+
+                        sum_pixel[i] += weight * pixel;
+                        sum_weight[i] += weight;
+                    }
+                }
+            }
+
+            for (int i = 0; i < num_lambda; ++i)
+                dstp[i][outer_y * dst_stride + outer_x] = static_cast<T>((sum_weight[i] == 0.f) ? avg : sum_pixel[i] / sum_weight[i]);
+        }
+    }
+}
+
+template<typename T, bool Aligned, bool Fast>
+static void dpidProcessSweepC(const void *srcp, int src_stride,
+    const float *avgp, int avg_stride,
+    void *const *dstp, int dst_stride,
+    const DpidGeometry &geometry, const float *lambda, int num_lambda, int y_begin, int y_end, DpidScratch &scratch) {
+
+    T *dst[DPID_SWEEP_MAX];
+    for (int i = 0; i < num_lambda; ++i)
+        dst[i] = static_cast<T *>(dstp[i]);
+
+    dpidProcessSweep<T, Aligned, Fast>(
+        static_cast<const T *>(srcp), src_stride,
+        avgp, avg_stride,
+        dst, dst_stride,
+        geometry, lambda, num_lambda, y_begin, y_end);
+}
+
+template<typename T>
+static DpidSweepKernel getSweepKernelC(bool fast, bool aligned) noexcept {
+    if (fast)
+        return aligned ? dpidProcessSweepC<T, true, true> : dpidProcessSweepC<T, false, true>;
+
+    return aligned ? dpidProcessSweepC<T, true, false> : dpidProcessSweepC<T, false, false>;
+}
+
+// DpidWeights; the guide is summed in plane order from 0 like in the
+// vectorized version, so a guide of one plane holds its samples exactly
+template<typename T, int Lambda>
+static void dpidWeightsC(const DpidGuidePlane *planes, int num_planes, int avg_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut,
+    float *weightp, int weight_stride, int y_begin, int y_end, DpidScratch &scratch) {
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int src_w = gx.src_size;
+    const int dst_w = gx.dst_size;
+    const float pow0 = std::pow(0.0f, lambda);
+
+    float *guide = scratch.get<float>(DPID_SCRATCH_ROWS, src_w);
+    float *avg = scratch.get<float>(DPID_SCRATCH_SUMS, dst_w);
+
+    int row_begin, row_end;
+    dpidOwnedRange(gy, y_begin, y_end, row_begin, row_end);
+
+    for (int inner_y = row_begin; inner_y < row_end; ++inner_y) {
+        const int outer_y = gy.owner[inner_y];
+
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+            float sum = 0.0f;
+            for (int j = 0; j < num_planes; ++j)
+                sum += planes[j].weight * planes[j].avgp[outer_y * avg_stride + outer_x];
+            avg[outer_x] = sum;
+        }
+
+        for (int inner_x = 0; inner_x < src_w; ++inner_x) {
+            float sum = 0.0f;
+            for (int j = 0; j < num_planes; ++j)
+                sum += planes[j].weight * static_cast<float>(static_cast<const T *>(planes[j].srcp)[inner_y * planes[j].src_stride + inner_x]);
+            guide[inner_x] = sum;
+        }
+
+        float *dst = weightp + inner_y * weight_stride;
+
+        for (int inner_x = 0; inner_x < src_w; ++inner_x) {
+            const float a = avg[gx.owner[inner_x]];
+            [[maybe_unused]] const int avg_q = static_cast<int>(a * 16.0f + 0.5f);
+            dst[inner_x] = pixelWeight<float, Lambda>(a, avg_q, guide[inner_x], lambda, pow0, lut);
+        }
+    }
+}
+
+// DpidSharedKernel: dpidProcess with the weights of the map
+template<typename T, bool Aligned>
+static void dpidProcessShared(const void *srcp_, int src_stride,
+    const float *avgp, int avg_stride,
+    const float *weightp, int weight_stride,
+    void *dstp_, int dst_stride,
+    const DpidGeometry &geometry, int y_begin, int y_end, DpidScratch &scratch) {
+
+    const T * VS_RESTRICT srcp = static_cast<const T *>(srcp_);
+    T * VS_RESTRICT dstp = static_cast<T *>(dstp_);
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int dst_w = gx.dst_size;
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+        const int syr = gy.begin[outer_y];
+        const int eyr = gy.end[outer_y];
+
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+            const float avg = avgp[outer_y * avg_stride + outer_x];
+            const int sxr = gx.begin[outer_x];
+            const int exr = gx.end[outer_x];
+
+            float sum_pixel {};
+            float sum_weight {};
+
+            for (int inner_y = syr; inner_y < eyr; ++inner_y) {
+                const float coverage_y = Aligned ? 1.0f : dpidCoverage(gy, outer_y, inner_y);
+
+                for (int inner_x = sxr; inner_x < exr; ++inner_x) {
+                    T pixel = srcp[inner_y * src_stride + inner_x];
+                    float weight = weightp[inner_y * weight_stride + inner_x];
+                    if constexpr (!Aligned)
+                        weight *= dpidCoverage(gx, outer_x, inner_x) * coverage_y;
+
+                    sum_pixel += weight * pixel;
+                    sum_weight += weight;
+                }
+            }
+
+            dstp[outer_y * dst_stride + outer_x] = static_cast<T>((sum_weight == 0.f) ? avg : sum_pixel / sum_weight);
+        }
+    }
+}
+
+// memory bound, not worth a vectorized version
+void dpidShrinkWeights(const float *srcp, int src_stride, float *dstp, int dst_stride,
+    int width, int shift_w, int shift_h, int y_begin, int y_end) noexcept {
+
+    const int block_w = 1 << shift_w;
+    const int block_h = 1 << shift_h;
+    const float scale = 1.0f / static_cast<float>(block_w * block_h);
+
+    for (int y = y_begin; y < y_end; ++y) {
+        float *dst = dstp + static_cast<ptrdiff_t>(y) * dst_stride;
+        std::fill(dst, dst + width, 0.0f);
+
+        for (int i = 0; i < block_h; ++i) {
+            const float *src = srcp + static_cast<ptrdiff_t>((y << shift_h) + i) * src_stride;
+
+            for (int x = 0; x < width; ++x) {
+                float sum = 0.0f;
+                for (int j = 0; j < block_w; ++j)
+                    sum += src[(x << shift_w) + j];
+                dst[x] += sum;
+            }
+        }
+
+        for (int x = 0; x < width; ++x)
+            dst[x] *= scale;
+    }
+}
+
+// DpidReduce: dpidProcess of every block with the block's mean as avg
+template<typename T, int Lambda>
+static void dpidReduce(const T * VS_RESTRICT srcp, int src_stride, int src_w, int src_h,
+    float * VS_RESTRICT dstp, int dst_stride, int factor, float lambda, const DpidLut *lut, int y_begin, int y_end) {
+
+    const int dst_w = dpidReducedSize(src_w, factor);
+    const float pow0 = std::pow(0.0f, lambda);
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+        const int syr = outer_y * factor;
+        const int eyr = std::min(syr + factor, src_h);
+
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+            const int sxr = outer_x * factor;
+            const int exr = std::min(sxr + factor, src_w);
+
+            float sum {};
+            for (int inner_y = syr; inner_y < eyr; ++inner_y)
+                for (int inner_x = sxr; inner_x < exr; ++inner_x)
+                    sum += static_cast<float>(srcp[inner_y * src_stride + inner_x]);
+
+            const float avg = sum / static_cast<float>((eyr - syr) * (exr - sxr));
+            [[maybe_unused]] const int avg_q = static_cast<int>(avg * 16.0f + 0.5f);
+
+            float sum_pixel {};
+            float sum_weight {};
+
+            for (int inner_y = syr; inner_y < eyr; ++inner_y) {
+                for (int inner_x = sxr; inner_x < exr; ++inner_x) {
+                    T pixel = srcp[inner_y * src_stride + inner_x];
+                    float weight = pixelWeight<T, Lambda>(avg, avg_q, pixel, lambda, pow0, lut);
+
+                    sum_pixel += weight * pixel;
+                    sum_weight += weight;
+                }
+            }
+
+            dstp[outer_y * dst_stride + outer_x] = (sum_weight == 0.f) ? avg : sum_pixel / sum_weight;
+        }
+    }
+}
+
+template<typename T, int Lambda>
+static void dpidReduceC(const void *srcp, int src_stride, int src_w, int src_h,
+    float *dstp, int dst_stride, int factor, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch) {
+
+    dpidReduce<T, Lambda>(static_cast<const T *>(srcp), src_stride, src_w, src_h,
+        dstp, dst_stride, factor, lambda, lut, y_begin, y_end);
+}
+
+template<typename T>
+static DpidReduce getReduceC(int lambda_class) noexcept {
+    switch (lambda_class) {
+    case DPID_LAMBDA_0:
+        return dpidReduceC<T, DPID_LAMBDA_0>;
+    case DPID_LAMBDA_0_5:
+        return dpidReduceC<T, DPID_LAMBDA_0_5>;
+    case DPID_LAMBDA_1:
+        return dpidReduceC<T, DPID_LAMBDA_1>;
+    case DPID_LAMBDA_2:
+        return dpidReduceC<T, DPID_LAMBDA_2>;
+    case DPID_LAMBDA_LUT:
+        if constexpr (std::is_integral_v<T>)
+            return dpidReduceC<T, DPID_LAMBDA_LUT>;
+        return nullptr;
+    case DPID_LAMBDA_LUT_LERP:
+        if constexpr (std::is_integral_v<T>)
+            return dpidReduceC<T, DPID_LAMBDA_LUT_LERP>;
+        return nullptr;
+    case DPID_LAMBDA_FAST:
+        return dpidReduceC<T, DPID_LAMBDA_FAST>;
+    default:
+        return dpidReduceC<T, DPID_LAMBDA_ANY>;
+    }
+}
+
+template<typename T>
+static void dpidStoreC(const float *srcp, int src_stride, void *dstp_, int dst_stride, int width, int y_begin, int y_end) {
+    T *dstp = static_cast<T *>(dstp_);
+
+    for (int y = y_begin; y < y_end; ++y)
+        for (int x = 0; x < width; ++x)
+            dstp[y * dst_stride + x] = static_cast<T>(srcp[y * src_stride + x]);
+}
+
+template<typename T, int Lambda>
+static DpidKernel getKernelC(bool aligned) noexcept {
+    return aligned ? dpidProcessC<T, Lambda, true> : dpidProcessC<T, Lambda, false>;
+}
+
+template<typename T>
+static DpidKernel getKernelC(int lambda_class, bool aligned) noexcept {
+    switch (lambda_class) {
+    case DPID_LAMBDA_0:
+        return getKernelC<T, DPID_LAMBDA_0>(aligned);
+    case DPID_LAMBDA_0_5:
+        return getKernelC<T, DPID_LAMBDA_0_5>(aligned);
+    case DPID_LAMBDA_1:
+        return getKernelC<T, DPID_LAMBDA_1>(aligned);
+    case DPID_LAMBDA_2:
+        return getKernelC<T, DPID_LAMBDA_2>(aligned);
+    case DPID_LAMBDA_LUT:
+        if constexpr (std::is_integral_v<T>)
+            return getKernelC<T, DPID_LAMBDA_LUT>(aligned);
+        return nullptr;
+    case DPID_LAMBDA_LUT_LERP:
+        if constexpr (std::is_integral_v<T>)
+            return getKernelC<T, DPID_LAMBDA_LUT_LERP>(aligned);
+        return nullptr;
+    case DPID_LAMBDA_FAST:
+        return getKernelC<T, DPID_LAMBDA_FAST>(aligned);
+    default:
+        return getKernelC<T, DPID_LAMBDA_ANY>(aligned);
+    }
+}
+
+
+template<typename T>
+static DpidKernel getHistogramKernelC(int lambda_class, bool aligned) noexcept {
+    switch (lambda_class) {
+    case DPID_LAMBDA_ANY:
+        return aligned ? dpidProcessHistogram<T, DPID_LAMBDA_ANY, true> : dpidProcessHistogram<T, DPID_LAMBDA_ANY, false>;
+    case DPID_LAMBDA_FAST:
+        return aligned ? dpidProcessHistogram<T, DPID_LAMBDA_FAST, true> : dpidProcessHistogram<T, DPID_LAMBDA_FAST, false>;
+    default:
+        return nullptr;
+    }
+}
+
+template<typename T>
+static DpidWeights getWeightsC(int lambda_class) noexcept {
+    switch (lambda_class) {
+    case DPID_LAMBDA_0:
+        return dpidWeightsC<T, DPID_LAMBDA_0>;
+    case DPID_LAMBDA_0_5:
+        return dpidWeightsC<T, DPID_LAMBDA_0_5>;
+    case DPID_LAMBDA_1:
+        return dpidWeightsC<T, DPID_LAMBDA_1>;
+    case DPID_LAMBDA_2:
+        return dpidWeightsC<T, DPID_LAMBDA_2>;
+    case DPID_LAMBDA_LUT:
+        if constexpr (std::is_integral_v<T>)
+            return dpidWeightsC<T, DPID_LAMBDA_LUT>;
+        return nullptr;
+    case DPID_LAMBDA_LUT_LERP:
+        if constexpr (std::is_integral_v<T>)
+            return dpidWeightsC<T, DPID_LAMBDA_LUT_LERP>;
+        return nullptr;
+    case DPID_LAMBDA_FAST:
+        return dpidWeightsC<T, DPID_LAMBDA_FAST>;
+    default:
+        return dpidWeightsC<T, DPID_LAMBDA_ANY>;
+    }
+}
+
+template<typename T>
+static DpidSharedKernel getSharedKernelC(bool aligned) noexcept {
+    return aligned ? dpidProcessShared<T, true> : dpidProcessShared<T, false>;
+}
+
+#ifdef DPID_X86
+static void cpuid(int regs[4], int leaf, int subleaf) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+    __cpuidex(regs, leaf, subleaf);
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    regs[0] = static_cast<int>(a);
+    regs[1] = static_cast<int>(b);
+    regs[2] = static_cast<int>(c);
+    regs[3] = static_cast<int>(d);
+#endif
+}
+
+static uint64_t xgetbv(unsigned int index) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(index);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static int detectCpuLevel() noexcept {
+    int regs[4];
+
+    cpuid(regs, 0, 0);
+    const int max_leaf = regs[0];
+    if (max_leaf < 1)
+        return DPID_OPT_C;
+
+    cpuid(regs, 1, 0);
+    const bool sse41 = regs[2] & (1 << 19);
+    const bool osxsave = regs[2] & (1 << 27);
+    const bool avx = regs[2] & (1 << 28);
+    const bool fma = regs[2] & (1 << 12);
+    const bool f16c = regs[2] & (1 << 29);
+
+    if (!sse41)
+        return DPID_OPT_C;
+
+    if (!osxsave || !avx || !fma || !f16c || max_leaf < 7)
+        return DPID_OPT_SSE41;
+
+    const uint64_t xcr0 = xgetbv(0);
+    if ((xcr0 & 0x6) != 0x6) // XMM and YMM state
+        return DPID_OPT_SSE41;
+
+    cpuid(regs, 7, 0);
+    const bool avx2 = regs[1] & (1 << 5);
+    const bool avx512f = regs[1] & (1 << 16);
+    const bool avx512dq = regs[1] & (1 << 17);
+    const bool avx512bw = regs[1] & (1 << 30);
+    const bool avx512vl = regs[1] & (1u << 31);
+
+    if (!avx2)
+        return DPID_OPT_SSE41;
+
+    if (!avx512f || !avx512dq || !avx512bw || !avx512vl || (xcr0 & 0xe6) != 0xe6) // opmask and ZMM state
+        return DPID_OPT_AVX2;
+
+    return DPID_OPT_AVX512;
+}
+#endif
+
+int dpidGetCpuLevel() noexcept {
+#ifdef DPID_X86
+    static const int level = detectCpuLevel();
+    return level;
+#else
+    return DPID_OPT_C;
+#endif
+}
+
+DpidResize dpidGetResize(int bytes_per_sample, bool is_float, int opt) noexcept {
+    if (opt == DPID_OPT_AUTO)
+        opt = dpidGetCpuLevel();
+
+#ifdef DPID_X86
+    if (opt >= DPID_OPT_AVX512)
+        return dpidGetResizeAVX512(bytes_per_sample, is_float);
+    else if (opt >= DPID_OPT_AVX2)
+        return dpidGetResizeAVX2(bytes_per_sample, is_float);
+    else if (opt >= DPID_OPT_SSE41)
+        return dpidGetResizeSSE41(bytes_per_sample, is_float);
+#endif
+
+    if (!is_float && bytes_per_sample == 1)
+        return dpid_resize::getResize<uint8_t>();
+    else if (!is_float && bytes_per_sample == 2)
+        return dpid_resize::getResize<uint16_t>();
+    else if (is_float && bytes_per_sample == 2)
+        return dpid_resize::getResize<DpidHalf>();
+    else if (is_float && bytes_per_sample == 4)
+        return dpid_resize::getResize<float>();
+
+    return nullptr;
+}
+
+DpidBlur dpidGetBlur(int bytes_per_sample, bool is_float, int opt) noexcept {
+    if (opt == DPID_OPT_AUTO)
+        opt = dpidGetCpuLevel();
+
+#ifdef DPID_X86
+    if (opt >= DPID_OPT_AVX512)
+        return dpidGetBlurAVX512(bytes_per_sample, is_float);
+    else if (opt >= DPID_OPT_AVX2)
+        return dpidGetBlurAVX2(bytes_per_sample, is_float);
+    else if (opt >= DPID_OPT_SSE41)
+        return dpidGetBlurSSE41(bytes_per_sample, is_float);
+#endif
+
+    if (!is_float && bytes_per_sample == 1)
+        return dpid_blur::getBlur<uint8_t>();
+    else if (!is_float && bytes_per_sample == 2)
+        return dpid_blur::getBlur<uint16_t>();
+    else if (is_float && bytes_per_sample == 2)
+        return dpid_blur::getBlur<DpidHalf>();
+    else if (is_float && bytes_per_sample == 4)
+        return dpid_blur::getBlur<float>();
+
+    return nullptr;
+}
+
+DpidKernel dpidGetKernel(int bytes_per_sample, bool is_float, int opt, int lambda_class, bool aligned) noexcept {
+    if (opt == DPID_OPT_AUTO)
+        opt = dpidGetCpuLevel();
+
+#ifdef DPID_X86
+    if (opt >= DPID_OPT_AVX512)
+        return dpidGetKernelAVX512(bytes_per_sample, is_float, lambda_class, aligned);
+    else if (opt >= DPID_OPT_AVX2)
+        return dpidGetKernelAVX2(bytes_per_sample, is_float, lambda_class, aligned);
+    else if (opt >= DPID_OPT_SSE41)
+        return dpidGetKernelSSE41(bytes_per_sample, is_float, lambda_class, aligned);
+#endif
+
+    if (!is_float && bytes_per_sample == 1)
+        return getKernelC<uint8_t>(lambda_class, aligned);
+    else if (!is_float && bytes_per_sample == 2)
+        return getKernelC<uint16_t>(lambda_class, aligned);
+    else if (is_float && bytes_per_sample == 2)
+        return getKernelC<DpidHalf>(lambda_class, aligned);
+    else if (is_float && bytes_per_sample == 4)
+        return getKernelC<float>(lambda_class, aligned);
+
+    return nullptr;
+}
+
+DpidSweepKernel dpidGetSweepKernel(int bytes_per_sample, bool is_float, int opt, bool fast, bool aligned) noexcept {
+    if (opt == DPID_OPT_AUTO)
+        opt = dpidGetCpuLevel();
+
+#ifdef DPID_X86
+    if (opt >= DPID_OPT_AVX512)
+        return dpidGetSweepKernelAVX512(bytes_per_sample, is_float, fast, aligned);
+    else if (opt >= DPID_OPT_AVX2)
+        return dpidGetSweepKernelAVX2(bytes_per_sample, is_float, fast, aligned);
+    else if (opt >= DPID_OPT_SSE41)
+        return dpidGetSweepKernelSSE41(bytes_per_sample, is_float, fast, aligned);
+#endif
+
+    if (!is_float && bytes_per_sample == 1)
+        return getSweepKernelC<uint8_t>(fast, aligned);
+    else if (!is_float && bytes_per_sample == 2)
+        return getSweepKernelC<uint16_t>(fast, aligned);
+    else if (is_float && bytes_per_sample == 2)
+        return getSweepKernelC<DpidHalf>(fast, aligned);
+    else if (is_float && bytes_per_sample == 4)
+        return getSweepKernelC<float>(fast, aligned);
+
+    return nullptr;
+}
+
+DpidKernel dpidGetHistogramKernel(int bytes_per_sample, int opt, int lambda_class, bool aligned) noexcept {
+    if (opt == DPID_OPT_AUTO)
+        opt = dpidGetCpuLevel();
+
+#ifdef DPID_X86
+    if (opt >= DPID_OPT_AVX512)
+        return dpidGetHistogramKernelAVX512(bytes_per_sample, lambda_class, aligned);
+    else if (opt >= DPID_OPT_AVX2)
+        return dpidGetHistogramKernelAVX2(bytes_per_sample, lambda_class, aligned);
+    else if (opt >= DPID_OPT_SSE41)
+        return dpidGetHistogramKernelSSE41(bytes_per_sample, lambda_class, aligned);
+#endif
+
+    if (bytes_per_sample == 1)
+        return getHistogramKernelC<uint8_t>(lambda_class, aligned);
+    else if (bytes_per_sample == 2)
+        return getHistogramKernelC<uint16_t>(lambda_class, aligned);
+
+    return nullptr;
+}
+
+DpidWeights dpidGetWeights(int bytes_per_sample, bool is_float, int opt, int lambda_class) noexcept {
+    if (opt == DPID_OPT_AUTO)
+        opt = dpidGetCpuLevel();
+
+#ifdef DPID_X86
+    if (opt >= DPID_OPT_AVX512)
+        return dpidGetWeightsAVX512(bytes_per_sample, is_float, lambda_class);
+    else if (opt >= DPID_OPT_AVX2)
+        return dpidGetWeightsAVX2(bytes_per_sample, is_float, lambda_class);
+    else if (opt >= DPID_OPT_SSE41)
+        return dpidGetWeightsSSE41(bytes_per_sample, is_float, lambda_class);
+#endif
+
+    if (!is_float && bytes_per_sample == 1)
+        return getWeightsC<uint8_t>(lambda_class);
+    else if (!is_float && bytes_per_sample == 2)
+        return getWeightsC<uint16_t>(lambda_class);
+    else if (is_float && bytes_per_sample == 2)
+        return getWeightsC<DpidHalf>(lambda_class);
+    else if (is_float && bytes_per_sample == 4)
+        return getWeightsC<float>(lambda_class);
+
+    return nullptr;
+}
+
+DpidSharedKernel dpidGetSharedKernel(int bytes_per_sample, bool is_float, int opt, bool aligned) noexcept {
+    if (opt == DPID_OPT_AUTO)
+        opt = dpidGetCpuLevel();
+
+#ifdef DPID_X86
+    if (opt >= DPID_OPT_AVX512)
+        return dpidGetSharedKernelAVX512(bytes_per_sample, is_float, aligned);
+    else if (opt >= DPID_OPT_AVX2)
+        return dpidGetSharedKernelAVX2(bytes_per_sample, is_float, aligned);
+    else if (opt >= DPID_OPT_SSE41)
+        return dpidGetSharedKernelSSE41(bytes_per_sample, is_float, aligned);
+#endif
+
+    if (!is_float && bytes_per_sample == 1)
+        return getSharedKernelC<uint8_t>(aligned);
+    else if (!is_float && bytes_per_sample == 2)
+        return getSharedKernelC<uint16_t>(aligned);
+    else if (is_float && bytes_per_sample == 2)
+        return getSharedKernelC<DpidHalf>(aligned);
+    else if (is_float && bytes_per_sample == 4)
+        return getSharedKernelC<float>(aligned);
+
+    return nullptr;
+}
+
+DpidReduce dpidGetReduce(int bytes_per_sample, bool is_float, int opt, int lambda_class) noexcept {
+    if (opt == DPID_OPT_AUTO)
+        opt = dpidGetCpuLevel();
+
+#ifdef DPID_X86
+    if (opt >= DPID_OPT_AVX512)
+        return dpidGetReduceAVX512(bytes_per_sample, is_float, lambda_class);
+    else if (opt >= DPID_OPT_AVX2)
+        return dpidGetReduceAVX2(bytes_per_sample, is_float, lambda_class);
+    else if (opt >= DPID_OPT_SSE41)
+        return dpidGetReduceSSE41(bytes_per_sample, is_float, lambda_class);
+#endif
+
+    if (!is_float && bytes_per_sample == 1)
+        return getReduceC<uint8_t>(lambda_class);
+    else if (!is_float && bytes_per_sample == 2)
+        return getReduceC<uint16_t>(lambda_class);
+    else if (is_float && bytes_per_sample == 2)
+        return getReduceC<DpidHalf>(lambda_class);
+    else if (is_float && bytes_per_sample == 4)
+        return getReduceC<float>(lambda_class);
+
+    return nullptr;
+}
+
+// output pixels only, not worth a vectorized version
+DpidStore dpidGetStore(int bytes_per_sample, bool is_float) noexcept {
+    if (!is_float && bytes_per_sample == 1)
+        return dpidStoreC<uint8_t>;
+    else if (!is_float && bytes_per_sample == 2)
+        return dpidStoreC<uint16_t>;
+    else if (is_float && bytes_per_sample == 2)
+        return dpidStoreC<DpidHalf>;
+    else if (is_float && bytes_per_sample == 4)
+        return dpidStoreC<float>;
+
+    return nullptr;
+}
@@ -0,0 +1,431 @@
+#ifndef DPID_H
+#define DPID_H
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DPID_X86 1
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+
+// values of the "opt" argument
+enum DpidOpt {
+    DPID_OPT_AUTO = 0,
+    DPID_OPT_C = 1,
+    DPID_OPT_SSE41 = 2,
+    DPID_OPT_AVX2 = 3,
+    DPID_OPT_AVX512 = 4,
+};
+
+// specializations of the range kernel pow(distance, lambda)
+enum DpidLambda {
+    DPID_LAMBDA_0,   // box filter
+    DPID_LAMBDA_0_5, // sqrt(distance)
+    DPID_LAMBDA_1,   // distance
+    DPID_LAMBDA_2,   // distance * distance
+    DPID_LAMBDA_ANY, // pow(distance, lambda)
+    DPID_LAMBDA_LUT, // DpidLut, looked up at 1/16 precision
+    DPID_LAMBDA_LUT_LERP, // DpidLut, interpolated
+    DPID_LAMBDA_FAST, // pow(distance, lambda) approximated, see dpidFastPow
+};
+
+static inline int dpidLambdaClass(float lambda) noexcept {
+    if (lambda == 0.0f)
+        return DPID_LAMBDA_0;
+    else if (lambda == 0.5f)
+        return DPID_LAMBDA_0_5;
+    else if (lambda == 1.0f)
+        return DPID_LAMBDA_1;
+    else if (lambda == 2.0f)
+        return DPID_LAMBDA_2;
+    else
+        return DPID_LAMBDA_ANY;
+}
+
+// Coefficients of the polynomials of DPID_LAMBDA_FAST: log2(1 + t) / t for t
+// in [sqrt(0.5) - 1, sqrt(2) - 1) and 2^f for f in [-0.5, 0.5], both fitted
+// for the smallest maximum error, highest degree first.
+inline constexpr float dpidFastLog2[] = {
+    -0.206589889f, 0.322154319f, -0.367490253f, 0.479348064f, -0.721131848f, 1.44271348f,
+};
+
+inline constexpr float dpidFastExp2[] = {
+    9.57009667e-3f, 5.59178599e-2f, 2.40247450e-1f, 6.93121815e-1f, 9.99999261e-1f,
+};
+
+// pow(distance, lambda) as exp2(lambda * log2(distance)) with the polynomials
+// above. The relative error is below 4e-6 * (1 + |lambda|) for distances of
+// at least FLT_MIN; smaller distances give pow(0, lambda) like a distance of 0,
+// so equal pixels keep weight 0 for positive lambda. The result saturates at
+// 2^-126 and 2^127.
+static inline float dpidFastPow(float distance, float lambda, float pow0) noexcept {
+    if (!(distance >= 1.17549435e-38f))
+        return pow0;
+
+    uint32_t bits;
+    std::memcpy(&bits, &distance, sizeof(bits));
+
+    // exponent and mantissa split at sqrt(0.5) instead of 1, so that the
+    // mantissa lands in [sqrt(0.5), sqrt(2)) without a comparison
+    bits += 0x3F800000u - 0x3F3504F3u;
+    const float e = static_cast<float>(static_cast<int>(bits >> 23) - 127);
+    bits = (bits & 0x007FFFFFu) + 0x3F3504F3u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    // Estrin's scheme, the dependency chain is what limits scalar code
+    const float t = m - 1.0f;
+    const float t2 = t * t;
+    const float p = ((dpidFastLog2[0] * t + dpidFastLog2[1]) * t2 + (dpidFastLog2[2] * t + dpidFastLog2[3])) * t2 +
+        (dpidFastLog2[4] * t + dpidFastLog2[5]);
+
+    const float y = std::min(std::max(lambda * (e + p * t), -126.0f), 127.0f);
+    // rounded through a positive value, which truncation floors
+    const int n = static_cast<int>(y + 126.5f) - 126;
+    const float f = y - n;
+
+    const float f2 = f * f;
+    const float r = (dpidFastExp2[0] * f2 + (dpidFastExp2[1] * f + dpidFastExp2[2])) * f2 +
+        (dpidFastExp2[3] * f + dpidFastExp2[4]);
+
+    const uint32_t scale_bits = static_cast<uint32_t>(n + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &scale_bits, sizeof(scale));
+
+    return r * scale;
+}
+
+// Table of pow(distance, lambda) for integer formats, replacing the range
+// kernel by a load. Up to 12 bits, avg is rounded to 1/16 so that every
+// distance has an entry; above that the table has 4096 steps over the value
+// range and is interpolated linearly.
+struct DpidLut {
+    std::vector<float> table;
+    float scale;      // entries per unit of distance
+    int lambda_class; // DPID_LAMBDA_LUT or DPID_LAMBDA_LUT_LERP
+};
+
+// Returns false if the table would not help or is not accurate enough:
+// float formats, lambda values with a cheaper kernel, lambda below 0.5, and
+// lambda below 1 above 12 bits.
+bool dpidMakeLut(DpidLut &lut, int bits_per_sample, bool is_float, float lambda);
+
+// Footprints of all output pixels along one axis. Output pixel `i` covers
+// source pixels [begin[i], end[i]); all of them are fully covered except the
+// first and the last one, whose coverage is in first[i] and last[i].
+// The tables are padded with empty footprints so that vector loads past
+// `dst_size` are safe.
+//
+// owner[pos] is the output pixel whose footprint covers most of source pixel
+// `pos`, the nearest one for pixels outside every footprint, and never
+// decreases with `pos`. It is padded with its last value like the others.
+struct DpidAxis {
+    int src_size, dst_size;
+    std::vector<int> begin, end;
+    std::vector<float> first, last;
+    std::vector<int> owner;
+};
+
+// Bilinear resampling along one axis, used by Dpid to compute its guide
+// internally. Output pixel `i` is the weighted sum of the `taps` source pixels
+// starting at left[i]; positions outside the plane are mirrored like zimg does.
+struct DpidFilter {
+    int taps;
+    std::vector<int> left;
+    std::vector<float> coeffs; // dst_size * taps
+};
+
+struct DpidGeometry {
+    DpidAxis x, y;
+    DpidFilter guide_x, guide_y; // empty unless built with `guide`
+    bool aligned; // every footprint starts and ends on the pixel grid
+};
+
+DpidGeometry dpidMakeGeometry(int src_w, int src_h, int dst_w, int dst_h,
+    float src_left, float src_top, float src_width, float src_height, bool guide);
+
+// coverage of source pixel `pos` by the footprint of output pixel `i`
+static inline float dpidCoverage(const DpidAxis &axis, int i, int pos) noexcept {
+    float c = 1.0f;
+    if (pos == axis.begin[i])
+        c *= axis.first[i];
+    if (pos == axis.end[i] - 1)
+        c *= axis.last[i];
+    return c;
+}
+
+// source pixels [pos_begin, pos_end) whose DpidAxis::owner is in [i_begin, i_end)
+static inline void dpidOwnedRange(const DpidAxis &axis, int i_begin, int i_end, int &pos_begin, int &pos_end) noexcept {
+    const auto end = axis.owner.begin() + axis.src_size;
+    pos_begin = static_cast<int>(std::lower_bound(axis.owner.begin(), end, i_begin) - axis.owner.begin());
+    pos_end = static_cast<int>(std::lower_bound(axis.owner.begin(), end, i_end) - axis.owner.begin());
+}
+
+// buffers of DpidScratch that a pass uses at the same time
+enum DpidScratchSlot {
+    DPID_SCRATCH_ROWS,      // converted source rows or filtered guide rows
+    DPID_SCRATCH_SUMS,      // accumulators of an output row
+    DPID_SCRATCH_COLUMNS,   // footprint widths of the output columns
+    DPID_SCRATCH_HISTOGRAM, // coverage of every sample value in a footprint
+    DPID_SCRATCH_SLOTS,
+};
+
+// Aligned scratch memory of one thread for the passes below. A buffer keeps
+// the largest size requested from its slot, so the passes stop allocating
+// once they have seen the largest plane of a filter. The contents are
+// undefined after a request with a different type or size.
+class DpidScratch {
+public:
+    DpidScratch() = default;
+    ~DpidScratch();
+
+    DpidScratch(const DpidScratch &) = delete;
+    DpidScratch &operator=(const DpidScratch &) = delete;
+
+    // `count` elements aligned to 64 bytes
+    template<typename T>
+    T *get(int slot, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 64, "scratch buffers hold plain data");
+        return static_cast<T *>(getBytes(slot, count * sizeof(T)));
+    }
+
+private:
+    void *getBytes(int slot, size_t bytes);
+
+    void *buffers[DPID_SCRATCH_SLOTS] = {};
+    size_t sizes[DPID_SCRATCH_SLOTS] = {};
+};
+
+// The passes below process output rows [y_begin, y_end) of a plane, so that a
+// plane can be split into bands that run concurrently. Their temporary
+// buffers come from `scratch`.
+
+// Computes the guide plane avg = RemoveGrain(down, 11) as float.
+// Strides are in samples, not bytes; `avg_stride` must be a multiple of 16.
+// Reads rows y_begin - 1 to y_end of `down`.
+using DpidBlur = void (*)(const void *downp, int down_stride,
+    float *avgp, int avg_stride, int width, int height, int y_begin, int y_end, DpidScratch &scratch);
+
+// Computes the bilinear downscale of the source plane, the input of DpidBlur
+// when Dpid generates its guide internally. `down_stride` is in samples.
+using DpidResize = void (*)(const void *srcp, int src_stride,
+    float *downp, int down_stride, const DpidGeometry &geometry, int y_begin, int y_end, DpidScratch &scratch);
+
+// Processes one plane, reading the guide plane produced by DpidBlur.
+// `lut` is only read by the DPID_LAMBDA_LUT* kernels.
+using DpidKernel = void (*)(const void *srcp, int src_stride,
+    const float *avgp, int avg_stride,
+    void *dstp, int dst_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch);
+
+// most lambda values of one DpidSweepKernel call
+constexpr int DPID_SWEEP_MAX = 8;
+
+// Processes one plane for `num_lambda` <= DPID_SWEEP_MAX lambda values at
+// once, writing the output of lambda[i] to dstp[i]. The footprint is read once
+// and the distances, and the logarithm of the general pow, are shared by all
+// lambda values. Every output is the one of DpidKernel with the lambda class
+// of its value, or DPID_LAMBDA_FAST with `fast` for the general ones, up to
+// multiply-adds the compiler fuses differently in the two kernels.
+using DpidSweepKernel = void (*)(const void *srcp, int src_stride,
+    const float *avgp, int avg_stride,
+    void *const *dstp, int dst_stride,
+    const DpidGeometry &geometry, const float *lambda, int num_lambda, int y_begin, int y_end, DpidScratch &scratch);
+
+// dpidGetHistogramKernel returns a DpidKernel for 8-16 bit integer planes
+// that first adds up the coverage of every sample value in a footprint and
+// then evaluates the range kernel once per distinct value instead of once per
+// source pixel, for the lambda classes DPID_LAMBDA_ANY and DPID_LAMBDA_FAST.
+// The output is the one of DpidKernel up to the order of the additions, which
+// may change integer output by 1.
+
+// Adds the coverage of every source pixel in the footprint of output pixel
+// (outer_x, outer_y) to hist[pixel] and appends the values that had no
+// coverage yet to `bins`. Returns the number of values appended. The pixels
+// of a row between its first and last one have the coverage of the row.
+template<typename T, bool Aligned>
+static inline int dpidFillHistogram(const T *srcp, int src_stride, const DpidGeometry &geometry,
+    int outer_x, int outer_y, float *hist, int *bins) noexcept {
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int sxr = gx.begin[outer_x];
+    const int exr = gx.end[outer_x];
+    int num_bins = 0;
+
+    // the bins are written unconditionally, so that new values cost no branch
+    const auto add = [&](int value, float coverage) {
+        bins[num_bins] = value;
+        num_bins += hist[value] == 0.0f;
+        hist[value] += coverage;
+    };
+
+    for (int inner_y = gy.begin[outer_y]; inner_y < gy.end[outer_y]; ++inner_y) {
+        const float coverage_y = Aligned ? 1.0f : dpidCoverage(gy, outer_y, inner_y);
+        const T *row = srcp + static_cast<ptrdiff_t>(inner_y) * src_stride;
+
+        if (Aligned || sxr + 1 >= exr) {
+            for (int inner_x = sxr; inner_x < exr; ++inner_x)
+                add(row[inner_x], Aligned ? 1.0f : dpidCoverage(gx, outer_x, inner_x) * coverage_y);
+        } else {
+            add(row[sxr], gx.first[outer_x] * coverage_y);
+            for (int inner_x = sxr + 1; inner_x < exr - 1; ++inner_x)
+                add(row[inner_x], coverage_y);
+            add(row[exr - 1], gx.last[outer_x] * coverage_y);
+        }
+    }
+
+    return num_bins;
+}
+
+// Whether the histogram kernel is used for a plane: integer samples of up to
+// 10 bits, a lambda class that needs pow and footprints of at least as many
+// source pixels on average as there are sample values, or four times as many
+// with DPID_LAMBDA_FAST, which costs less per pixel. Below that, noisy
+// footprints have too few repeated values for it to be faster.
+static inline bool dpidUseHistogram(int bits_per_sample, bool is_float, int lambda_class, const DpidGeometry &geometry) noexcept {
+    if (is_float || bits_per_sample > 10)
+        return false;
+
+    const auto mean_size = [](const DpidAxis &axis) {
+        float sum = 0.0f;
+        for (int i = 0; i < axis.dst_size; ++i)
+            sum += static_cast<float>(axis.end[i] - axis.begin[i]);
+        return sum / static_cast<float>(axis.dst_size);
+    };
+
+    const float area = mean_size(geometry.x) * mean_size(geometry.y);
+    const float values = static_cast<float>(1 << bits_per_sample);
+
+    if (lambda_class == DPID_LAMBDA_ANY)
+        return area >= values;
+    else if (lambda_class == DPID_LAMBDA_FAST)
+        return area >= 4.0f * values;
+
+    return false;
+}
+
+// most planes of the guide of shared_weights
+constexpr int DPID_GUIDE_MAX = 3;
+
+// one plane of the guide of shared_weights; the guide is the sum of the
+// planes multiplied by `weight`
+struct DpidGuidePlane {
+    const void *srcp;
+    int src_stride; // in samples
+    const float *avgp; // the avg_stride of the call
+    float weight;
+};
+
+// Computes the weight map of shared_weights: the range kernel of every source
+// pixel of the guide against the guide value of its DpidAxis::owner, without
+// coverage, for `num_planes` <= DPID_GUIDE_MAX planes with the same geometry.
+// Writes the source rows owned by output rows [y_begin, y_end) as float;
+// `weight_stride` is in samples and at least dpidAvgStride(src_size).
+// `lut` is only read by the DPID_LAMBDA_LUT* kernels, which need a guide of
+// one plane with weight 1.
+using DpidWeights = void (*)(const DpidGuidePlane *planes, int num_planes, int avg_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut,
+    float *weightp, int weight_stride, int y_begin, int y_end, DpidScratch &scratch);
+
+// Processes one plane like DpidKernel with the weights read from a weight map
+// of the size of the source plane instead of computed by the range kernel,
+// so that the output is the one of DpidKernel where that map holds the
+// weights DpidKernel would compute.
+using DpidSharedKernel = void (*)(const void *srcp, int src_stride,
+    const float *avgp, int avg_stride,
+    const float *weightp, int weight_stride,
+    void *dstp, int dst_stride,
+    const DpidGeometry &geometry, int y_begin, int y_end, DpidScratch &scratch);
+
+// Scales a weight map down to a plane subsampled by 2^shift_w x 2^shift_h,
+// every weight being the mean of its block. Writes rows [y_begin, y_end) of
+// the `width` x `height` map at `dstp`. Strides are in samples.
+void dpidShrinkWeights(const float *srcp, int src_stride, float *dstp, int dst_stride,
+    int width, int shift_w, int shift_h, int y_begin, int y_end) noexcept;
+
+// Reduces a source plane by `factor` in both directions for hierarchical=True.
+// Every block of factor x factor source pixels, smaller at the right and
+// bottom edges, becomes the weighted mean of the block with the block's own
+// mean as the guide and the range kernel of `lambda_class`, the output of
+// DpidKernel for an aligned footprint. Writes rows [y_begin, y_end) of the
+// reduced plane as float; `dst_stride` is in samples.
+using DpidReduce = void (*)(const void *srcp, int src_stride, int src_w, int src_h,
+    float *dstp, int dst_stride, int factor, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch);
+
+// size of the plane reduced by DpidReduce
+static inline int dpidReducedSize(int size, int factor) noexcept {
+    return (size + factor - 1) / factor;
+}
+
+// Pre-reduction of hierarchical=True for a downscale `factor`: leaves 8 to 16
+// to the kernel, and 1 (none) below 32 where the reduction is not faster than
+// the exact path.
+static inline int dpidReduceFactor(float factor) noexcept {
+    const int reduce = static_cast<int>(factor / 8.0f);
+    return reduce >= 4 ? reduce : 1;
+}
+
+// Converts rows [y_begin, y_end) of a float plane to the sample type the way
+// the kernels store their output. Strides are in samples.
+using DpidStore = void (*)(const float *srcp, int src_stride, void *dstp, int dst_stride, int width, int y_begin, int y_end);
+
+// guide plane stride for the given width
+static inline int dpidAvgStride(int width) noexcept {
+    return (width + 15) / 16 * 16;
+}
+
+// highest DPID_OPT_* level supported by the running CPU
+int dpidGetCpuLevel() noexcept;
+
+// return nullptr for unsupported formats
+DpidResize dpidGetResize(int bytes_per_sample, bool is_float, int opt) noexcept;
+DpidBlur dpidGetBlur(int bytes_per_sample, bool is_float, int opt) noexcept;
+DpidKernel dpidGetKernel(int bytes_per_sample, bool is_float, int opt, int lambda_class, bool aligned) noexcept;
+DpidSweepKernel dpidGetSweepKernel(int bytes_per_sample, bool is_float, int opt, bool fast, bool aligned) noexcept;
+DpidKernel dpidGetHistogramKernel(int bytes_per_sample, int opt, int lambda_class, bool aligned) noexcept;
+DpidWeights dpidGetWeights(int bytes_per_sample, bool is_float, int opt, int lambda_class) noexcept;
+DpidSharedKernel dpidGetSharedKernel(int bytes_per_sample, bool is_float, int opt, bool aligned) noexcept;
+DpidReduce dpidGetReduce(int bytes_per_sample, bool is_float, int opt, int lambda_class) noexcept;
+DpidStore dpidGetStore(int bytes_per_sample, bool is_float) noexcept;
+
+#ifdef DPID_X86
+DpidResize dpidGetResizeSSE41(int bytes_per_sample, bool is_float) noexcept;
+DpidResize dpidGetResizeAVX2(int bytes_per_sample, bool is_float) noexcept;
+DpidResize dpidGetResizeAVX512(int bytes_per_sample, bool is_float) noexcept;
+
+DpidBlur dpidGetBlurSSE41(int bytes_per_sample, bool is_float) noexcept;
+DpidBlur dpidGetBlurAVX2(int bytes_per_sample, bool is_float) noexcept;
+DpidBlur dpidGetBlurAVX512(int bytes_per_sample, bool is_float) noexcept;
+
+DpidKernel dpidGetKernelSSE41(int bytes_per_sample, bool is_float, int lambda_class, bool aligned) noexcept;
+DpidKernel dpidGetKernelAVX2(int bytes_per_sample, bool is_float, int lambda_class, bool aligned) noexcept;
+DpidKernel dpidGetKernelAVX512(int bytes_per_sample, bool is_float, int lambda_class, bool aligned) noexcept;
+
+DpidSweepKernel dpidGetSweepKernelSSE41(int bytes_per_sample, bool is_float, bool fast, bool aligned) noexcept;
+DpidSweepKernel dpidGetSweepKernelAVX2(int bytes_per_sample, bool is_float, bool fast, bool aligned) noexcept;
+DpidSweepKernel dpidGetSweepKernelAVX512(int bytes_per_sample, bool is_float, bool fast, bool aligned) noexcept;
+
+DpidKernel dpidGetHistogramKernelSSE41(int bytes_per_sample, int lambda_class, bool aligned) noexcept;
+DpidKernel dpidGetHistogramKernelAVX2(int bytes_per_sample, int lambda_class, bool aligned) noexcept;
+DpidKernel dpidGetHistogramKernelAVX512(int bytes_per_sample, int lambda_class, bool aligned) noexcept;
+
+DpidWeights dpidGetWeightsSSE41(int bytes_per_sample, bool is_float, int lambda_class) noexcept;
+DpidWeights dpidGetWeightsAVX2(int bytes_per_sample, bool is_float, int lambda_class) noexcept;
+DpidWeights dpidGetWeightsAVX512(int bytes_per_sample, bool is_float, int lambda_class) noexcept;
+
+DpidSharedKernel dpidGetSharedKernelSSE41(int bytes_per_sample, bool is_float, bool aligned) noexcept;
+DpidSharedKernel dpidGetSharedKernelAVX2(int bytes_per_sample, bool is_float, bool aligned) noexcept;
+DpidSharedKernel dpidGetSharedKernelAVX512(int bytes_per_sample, bool is_float, bool aligned) noexcept;
+
+DpidReduce dpidGetReduceSSE41(int bytes_per_sample, bool is_float, int lambda_class) noexcept;
+DpidReduce dpidGetReduceAVX2(int bytes_per_sample, bool is_float, int lambda_class) noexcept;
+DpidReduce dpidGetReduceAVX512(int bytes_per_sample, bool is_float, int lambda_class) noexcept;
+#endif
+
+#endif // DPID_H
@@ -0,0 +1,92 @@
+#include <immintrin.h>
+
+#include "dpid_simd.h"
+
+
+namespace {
+
+struct VecAVX2 {
+    static constexpr int width = 8;
+
+    using f = __m256;
+    using i = __m256i;
+    using m = __m256;
+
+    static f zero() { return _mm256_setzero_ps(); }
+    static f set1(float x) { return _mm256_set1_ps(x); }
+    static f load(const float * p) { return _mm256_load_ps(p); }
+    static f loadu(const float * p) { return _mm256_loadu_ps(p); }
+    static void store(float * p, f x) { _mm256_store_ps(p, x); }
+    static void storeu(float * p, f x) { _mm256_storeu_ps(p, x); }
+
+    static f loadh(const uint16_t * p) { return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))); }
+    static void storeh(uint16_t * p, f x) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT));
+    }
+
+    static f add(f a, f b) { return _mm256_add_ps(a, b); }
+    static f sub(f a, f b) { return _mm256_sub_ps(a, b); }
+    static f mul(f a, f b) { return _mm256_mul_ps(a, b); }
+    static f div(f a, f b) { return _mm256_div_ps(a, b); }
+    static f min(f a, f b) { return _mm256_min_ps(a, b); }
+    static f max(f a, f b) { return _mm256_max_ps(a, b); }
+    static f abs(f a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static f sqrt(f a) { return _mm256_sqrt_ps(a); }
+    static f floor(f a) { return _mm256_floor_ps(a); }
+    static f ceil(f a) { return _mm256_ceil_ps(a); }
+
+    static m lt(f a, f b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static m gt(f a, f b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static m eq(f a, f b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static f select(m mask, f a, f b) { return _mm256_blendv_ps(b, a, mask); }
+
+    static i cvtt(f a) { return _mm256_cvttps_epi32(a); }
+    static f cvt(i a) { return _mm256_cvtepi32_ps(a); }
+    static i castfi(f a) { return _mm256_castps_si256(a); }
+    static f castif(i a) { return _mm256_castsi256_ps(a); }
+    static i iloadu(const int * p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    static i iset1(int x) { return _mm256_set1_epi32(x); }
+    static i iadd(i a, i b) { return _mm256_add_epi32(a, b); }
+    static i isub(i a, i b) { return _mm256_sub_epi32(a, b); }
+    static i iand(i a, i b) { return _mm256_and_si256(a, b); }
+    static i ior(i a, i b) { return _mm256_or_si256(a, b); }
+    static i isrl23(i a) { return _mm256_srli_epi32(a, 23); }
+    static i isll23(i a) { return _mm256_slli_epi32(a, 23); }
+
+    static f gather(const float * p, i idx) { return _mm256_i32gather_ps(p, idx, 4); }
+};
+
+} // namespace
+
+
+DpidResize dpidGetResizeAVX2(int bytes_per_sample, bool is_float) noexcept {
+    return dpid_simd::getResize(bytes_per_sample, is_float);
+}
+
+DpidBlur dpidGetBlurAVX2(int bytes_per_sample, bool is_float) noexcept {
+    return dpid_simd::getBlur(bytes_per_sample, is_float);
+}
+
+DpidKernel dpidGetKernelAVX2(int bytes_per_sample, bool is_float, int lambda_class, bool aligned) noexcept {
+    return dpid_simd::getKernel<VecAVX2>(bytes_per_sample, is_float, lambda_class, aligned);
+}
+
+DpidSweepKernel dpidGetSweepKernelAVX2(int bytes_per_sample, bool is_float, bool fast, bool aligned) noexcept {
+    return dpid_simd::getSweepKernel<VecAVX2>(bytes_per_sample, is_float, fast, aligned);
+}
+
+DpidKernel dpidGetHistogramKernelAVX2(int bytes_per_sample, int lambda_class, bool aligned) noexcept {
+    return dpid_simd::getHistogramKernel<VecAVX2>(bytes_per_sample, lambda_class, aligned);
+}
+
+DpidWeights dpidGetWeightsAVX2(int bytes_per_sample, bool is_float, int lambda_class) noexcept {
+    return dpid_simd::getWeights<VecAVX2>(bytes_per_sample, is_float, lambda_class);
+}
+
+DpidSharedKernel dpidGetSharedKernelAVX2(int bytes_per_sample, bool is_float, bool aligned) noexcept {
+    return dpid_simd::getSharedKernel<VecAVX2>(bytes_per_sample, is_float, aligned);
+}
+
+DpidReduce dpidGetReduceAVX2(int bytes_per_sample, bool is_float, int lambda_class) noexcept {
+    return dpid_simd::getReduce<VecAVX2>(bytes_per_sample, is_float, lambda_class);
+}
@@ -0,0 +1,115 @@
+#include <immintrin.h>
+
+#include "dpid_simd.h"
+
+
+// GCC 12 reports the _mm512_undefined_* pass-through operand of some AVX-512
+// intrinsics as maybe or definitely uninitialized wherever they are inlined
+// (GCC bug 105593). The warnings are off only for the wrappers of those
+// intrinsics, so that the kernels are still checked.
+#if defined(__GNUC__) && !defined(__clang__)
+#define DPID_PASSTHROUGH_BEGIN \
+    _Pragma("GCC diagnostic push") \
+    _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"") \
+    _Pragma("GCC diagnostic ignored \"-Wuninitialized\"")
+#define DPID_PASSTHROUGH_END _Pragma("GCC diagnostic pop")
+#else
+#define DPID_PASSTHROUGH_BEGIN
+#define DPID_PASSTHROUGH_END
+#endif
+
+namespace {
+
+struct VecAVX512 {
+    static constexpr int width = 16;
+
+    using f = __m512;
+    using i = __m512i;
+    using m = __mmask16;
+
+    static f zero() { return _mm512_setzero_ps(); }
+    static f set1(float x) { return _mm512_set1_ps(x); }
+    static f load(const float * p) { return _mm512_load_ps(p); }
+    static f loadu(const float * p) { return _mm512_loadu_ps(p); }
+    static void store(float * p, f x) { _mm512_store_ps(p, x); }
+    static void storeu(float * p, f x) { _mm512_storeu_ps(p, x); }
+
+DPID_PASSTHROUGH_BEGIN
+    static f loadh(const uint16_t * p) { return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))); }
+    static void storeh(uint16_t * p, f x) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm512_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT));
+    }
+DPID_PASSTHROUGH_END
+
+    static f add(f a, f b) { return _mm512_add_ps(a, b); }
+    static f sub(f a, f b) { return _mm512_sub_ps(a, b); }
+    static f mul(f a, f b) { return _mm512_mul_ps(a, b); }
+    static f div(f a, f b) { return _mm512_div_ps(a, b); }
+DPID_PASSTHROUGH_BEGIN
+    static f min(f a, f b) { return _mm512_min_ps(a, b); }
+    static f max(f a, f b) { return _mm512_max_ps(a, b); }
+    static f abs(f a) { return _mm512_abs_ps(a); }
+    static f sqrt(f a) { return _mm512_sqrt_ps(a); }
+    static f floor(f a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+    static f ceil(f a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC); }
+DPID_PASSTHROUGH_END
+
+    static m lt(f a, f b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static m gt(f a, f b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static m eq(f a, f b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static f select(m mask, f a, f b) { return _mm512_mask_blend_ps(mask, b, a); }
+
+DPID_PASSTHROUGH_BEGIN
+    static i cvtt(f a) { return _mm512_cvttps_epi32(a); }
+    static f cvt(i a) { return _mm512_cvtepi32_ps(a); }
+DPID_PASSTHROUGH_END
+    static i castfi(f a) { return _mm512_castps_si512(a); }
+    static f castif(i a) { return _mm512_castsi512_ps(a); }
+    static i iloadu(const int * p) { return _mm512_loadu_si512(p); }
+    static i iset1(int x) { return _mm512_set1_epi32(x); }
+    static i iadd(i a, i b) { return _mm512_add_epi32(a, b); }
+    static i isub(i a, i b) { return _mm512_sub_epi32(a, b); }
+    static i iand(i a, i b) { return _mm512_and_si512(a, b); }
+    static i ior(i a, i b) { return _mm512_or_si512(a, b); }
+DPID_PASSTHROUGH_BEGIN
+    static i isrl23(i a) { return _mm512_srli_epi32(a, 23); }
+    static i isll23(i a) { return _mm512_slli_epi32(a, 23); }
+
+    static f gather(const float * p, i idx) { return _mm512_i32gather_ps(idx, p, 4); }
+DPID_PASSTHROUGH_END
+};
+
+} // namespace
+
+
+DpidResize dpidGetResizeAVX512(int bytes_per_sample, bool is_float) noexcept {
+    return dpid_simd::getResize(bytes_per_sample, is_float);
+}
+
+DpidBlur dpidGetBlurAVX512(int bytes_per_sample, bool is_float) noexcept {
+    return dpid_simd::getBlur(bytes_per_sample, is_float);
+}
+
+DpidKernel dpidGetKernelAVX512(int bytes_per_sample, bool is_float, int lambda_class, bool aligned) noexcept {
+    return dpid_simd::getKernel<VecAVX512>(bytes_per_sample, is_float, lambda_class, aligned);
+}
+
+DpidSweepKernel dpidGetSweepKernelAVX512(int bytes_per_sample, bool is_float, bool fast, bool aligned) noexcept {
+    return dpid_simd::getSweepKernel<VecAVX512>(bytes_per_sample, is_float, fast, aligned);
+}
+
+DpidKernel dpidGetHistogramKernelAVX512(int bytes_per_sample, int lambda_class, bool aligned) noexcept {
+    return dpid_simd::getHistogramKernel<VecAVX512>(bytes_per_sample, lambda_class, aligned);
+}
+
+DpidWeights dpidGetWeightsAVX512(int bytes_per_sample, bool is_float, int lambda_class) noexcept {
+    return dpid_simd::getWeights<VecAVX512>(bytes_per_sample, is_float, lambda_class);
+}
+
+DpidSharedKernel dpidGetSharedKernelAVX512(int bytes_per_sample, bool is_float, bool aligned) noexcept {
+    return dpid_simd::getSharedKernel<VecAVX512>(bytes_per_sample, is_float, aligned);
+}
+
+DpidReduce dpidGetReduceAVX512(int bytes_per_sample, bool is_float, int lambda_class) noexcept {
+    return dpid_simd::getReduce<VecAVX512>(bytes_per_sample, is_float, lambda_class);
+}
@@ -0,0 +1,64 @@
+#ifndef DPID_BLUR_H
+#define DPID_BLUR_H
+
+// RemoveGrain(down, 11) as a separable [1 2 1] filter with replicated borders.
+// The row functions are usable on their own so that a kernel can fuse the
+// pass row by row; blurPlane() runs it over a whole plane.
+
+#include <algorithm>
+#include <cstddef>
+
+#include "dpid.h"
+
+namespace dpid_blur {
+
+// horizontal [1 2 1] pass of one row
+template<typename T>
+static inline void blurRowH(const T * src, float * dst, int w) {
+    if (w == 1) {
+        dst[0] = 4.0f * src[0];
+        return;
+    }
+
+    dst[0] = 3.0f * src[0] + src[1];
+    for (int x = 1; x < w - 1; ++x)
+        dst[x] = static_cast<float>(src[x - 1]) + 2.0f * src[x] + src[x + 1];
+    dst[w - 1] = static_cast<float>(src[w - 2]) + 3.0f * src[w - 1];
+}
+
+// vertical [1 2 1] pass over three horizontally filtered rows, normalized
+static inline void blurRowV(const float * r0, const float * r1, const float * r2, float * dst, int w) {
+    for (int x = 0; x < w; ++x)
+        dst[x] = (r0[x] + 2.0f * r1[x] + r2[x]) * (1.0f / 16.0f);
+}
+
+template<typename T>
+static void blurPlane(const void * downp_, int down_stride, float * avgp, int avg_stride, int width, int height,
+    int y_begin, int y_end, DpidScratch & scratch) {
+
+    const T * downp = static_cast<const T *>(downp_);
+
+    float * buf = scratch.get<float>(DPID_SCRATCH_ROWS, static_cast<size_t>(width) * 3);
+    float * ring[3] = { buf, buf + width, buf + 2 * width };
+
+    blurRowH(downp + static_cast<ptrdiff_t>(std::max(y_begin - 1, 0)) * down_stride, ring[0], width);
+    blurRowH(downp + static_cast<ptrdiff_t>(y_begin) * down_stride, ring[1], width);
+
+    for (int y = y_begin; y < y_end; ++y) {
+        const int next = std::min(y + 1, height - 1);
+
+        blurRowH(downp + static_cast<ptrdiff_t>(next) * down_stride, ring[2], width);
+        blurRowV(ring[0], ring[1], ring[2], avgp + static_cast<ptrdiff_t>(y) * avg_stride, width);
+
+        std::rotate(ring, ring + 1, ring + 3);
+    }
+}
+
+template<typename T>
+static DpidBlur getBlur() noexcept {
+    return blurPlane<T>;
+}
+
+} // namespace dpid_blur
+
+#endif // DPID_BLUR_H
@@ -0,0 +1,261 @@
+#include "dpid_cache.h"
+#include <algorithm>
+#include <cstring>
+
+
+static constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotl(uint64_t x, int r) noexcept {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p) noexcept {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p) noexcept {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t input) noexcept {
+    return rotl(acc + input * prime2, 31) * prime1;
+}
+
+static inline uint64_t hashMerge(uint64_t acc, uint64_t lane) noexcept {
+    return (acc ^ hashRound(0, lane)) * prime1 + prime4;
+}
+
+DpidHash::DpidHash(uint64_t seed) noexcept :
+    seed(seed), lanes{seed + prime1 + prime2, seed + prime2, seed, seed - prime1} {}
+
+void DpidHash::update(const void *data, size_t bytes) noexcept {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    const unsigned char *end = p + bytes;
+    total += bytes;
+
+    if (buffered + bytes < sizeof(buffer)) {
+        std::memcpy(buffer + buffered, p, bytes);
+        buffered += bytes;
+        return;
+    }
+
+    if (buffered) {
+        const size_t fill = sizeof(buffer) - buffered;
+        std::memcpy(buffer + buffered, p, fill);
+        p += fill;
+        buffered = 0;
+
+        for (int i = 0; i < 4; ++i)
+            lanes[i] = hashRound(lanes[i], read64(buffer + i * 8));
+    }
+
+    uint64_t v0 = lanes[0], v1 = lanes[1], v2 = lanes[2], v3 = lanes[3];
+
+    for (; end - p >= 32; p += 32) {
+        v0 = hashRound(v0, read64(p));
+        v1 = hashRound(v1, read64(p + 8));
+        v2 = hashRound(v2, read64(p + 16));
+        v3 = hashRound(v3, read64(p + 24));
+    }
+
+    lanes[0] = v0;
+    lanes[1] = v1;
+    lanes[2] = v2;
+    lanes[3] = v3;
+
+    buffered = static_cast<size_t>(end - p);
+    std::memcpy(buffer, p, buffered);
+}
+
+uint64_t DpidHash::digest() const noexcept {
+    uint64_t h;
+
+    if (total >= 32) {
+        h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        for (int i = 0; i < 4; ++i)
+            h = hashMerge(h, lanes[i]);
+    } else {
+        h = seed + prime5;
+    }
+
+    h += total;
+
+    const unsigned char *p = buffer;
+    const unsigned char *end = buffer + buffered;
+
+    for (; end - p >= 8; p += 8)
+        h = rotl(h ^ hashRound(0, read64(p)), 27) * prime1 + prime4;
+
+    if (end - p >= 4) {
+        h = rotl(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    for (; p < end; ++p)
+        h = rotl(h ^ (*p * prime5), 11) * prime1;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+DpidCacheEntry::~DpidCacheEntry() {
+    vsapi->freeFrame(src1);
+    if (src2)
+        vsapi->freeFrame(src2);
+    for (const VSFrame *frame : dst)
+        vsapi->freeFrame(frame);
+}
+
+DpidFrameCache::DpidFrameCache(int capacity, const VSAPI *vsapi) : capacity(capacity), vsapi(vsapi) {
+    entries.reserve(capacity);
+}
+
+// Calls f(source, frame, plane) for the planes the output depends on; `source`
+// is 0 for src1 and 1 for src2.
+template<typename F>
+static void forEachPlane(const DpidCacheKey &key, const VSAPI *vsapi, F &&f) {
+    const int num_planes = vsapi->getVideoFrameFormat(key.src1)->numPlanes;
+
+    for (int plane = 0; plane < num_planes; ++plane) {
+        if (key.process[plane])
+            f(0, key.src1, plane);
+        if (key.src2)
+            f(1, key.src2, plane);
+    }
+}
+
+uint64_t DpidFrameCache::hash(const DpidCacheKey &key) const {
+    DpidHash h(static_cast<uint64_t>(key.tag));
+
+    forEachPlane(key, vsapi, [&](int source, const VSFrame *frame, int plane) {
+        const uint8_t *p = vsapi->getReadPtr(frame, plane);
+        const ptrdiff_t stride = vsapi->getStride(frame, plane);
+        const size_t row = static_cast<size_t>(vsapi->getFrameWidth(frame, plane)) * vsapi->getVideoFrameFormat(frame)->bytesPerSample;
+        const int height = vsapi->getFrameHeight(frame, plane);
+
+        for (int y = 0; y < height; ++y, p += stride)
+            h.update(p, row);
+    });
+
+    return h.digest();
+}
+
+// the entry's sources are the same frames, or repetitions of them
+bool DpidFrameCache::sameBuffers(const DpidCacheEntry &entry, const DpidCacheKey &key) const {
+    if (entry.tag != key.tag || !entry.src2 != !key.src2)
+        return false;
+
+    bool same = true;
+
+    forEachPlane(key, vsapi, [&](int source, const VSFrame *frame, int plane) {
+        const VSFrame *cached = source ? entry.src2 : entry.src1;
+        same = same && vsapi->getReadPtr(cached, plane) == vsapi->getReadPtr(frame, plane);
+    });
+
+    return same;
+}
+
+bool DpidFrameCache::sameContent(const DpidCacheEntry &entry, const DpidCacheKey &key) const {
+    if (entry.tag != key.tag || entry.hash != key.hash || !entry.src2 != !key.src2)
+        return false;
+
+    bool same = true;
+
+    forEachPlane(key, vsapi, [&](int source, const VSFrame *frame, int plane) {
+        const VSFrame *cached = source ? entry.src2 : entry.src1;
+        const uint8_t *p = vsapi->getReadPtr(frame, plane);
+        const uint8_t *q = vsapi->getReadPtr(cached, plane);
+        const ptrdiff_t p_stride = vsapi->getStride(frame, plane);
+        const ptrdiff_t q_stride = vsapi->getStride(cached, plane);
+        const size_t row = static_cast<size_t>(vsapi->getFrameWidth(frame, plane)) * vsapi->getVideoFrameFormat(frame)->bytesPerSample;
+        const int height = vsapi->getFrameHeight(frame, plane);
+
+        if (p == q)
+            return;
+
+        for (int y = 0; y < height && same; ++y, p += p_stride, q += q_stride)
+            same = std::memcmp(p, q, row) == 0;
+    });
+
+    return same;
+}
+
+std::shared_ptr<const DpidCacheEntry> DpidFrameCache::find(DpidCacheKey &key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const auto &entry : entries) {
+            if (sameBuffers(*entry, key)) {
+                entry->last_use = ++clock;
+                return entry;
+            }
+        }
+    }
+
+    key.hash = hash(key);
+
+    std::shared_ptr<DpidCacheEntry> candidate;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const auto &entry : entries) {
+            if (entry->hash == key.hash && entry->tag == key.tag) {
+                candidate = entry;
+                break;
+            }
+        }
+    }
+
+    // compared without the lock, the entry stays alive while it is referenced
+    if (!candidate || !sameContent(*candidate, key))
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    candidate->last_use = ++clock;
+    return candidate;
+}
+
+void DpidFrameCache::insert(const DpidCacheKey &key, const std::vector<VSFrame *> &dst, VSCore *core) {
+    auto entry = std::make_shared<DpidCacheEntry>();
+    entry->vsapi = vsapi;
+    entry->src1 = vsapi->addFrameRef(key.src1);
+    entry->src2 = key.src2 ? vsapi->addFrameRef(key.src2) : nullptr;
+    entry->tag = key.tag;
+    entry->hash = key.hash;
+
+    // the planes are shared, the properties of `dst` may still change
+    for (VSFrame *frame : dst)
+        entry->dst.push_back(vsapi->copyFrame(frame, core));
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // another thread filtered the same content concurrently
+    for (const auto &cached : entries) {
+        if (cached->hash == key.hash && cached->tag == key.tag)
+            return;
+    }
+
+    entry->last_use = ++clock;
+
+    if (static_cast<int>(entries.size()) < capacity) {
+        entries.push_back(std::move(entry));
+        return;
+    }
+
+    auto oldest = std::min_element(entries.begin(), entries.end(),
+        [](const auto &a, const auto &b) { return a->last_use < b->last_use; });
+    *oldest = std::move(entry);
+}
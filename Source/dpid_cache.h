@@ -0,0 +1,84 @@
+#ifndef DPID_CACHE_H
+#define DPID_CACHE_H
+
+#include "VapourSynth4.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// 64 bit hash of a sequence of bytes, XXH64. The four lanes of a 32 byte
+// stripe are independent, so the multiplications overlap and the hash runs at
+// several bytes per cycle without vector instructions.
+class DpidHash {
+public:
+    explicit DpidHash(uint64_t seed = 0) noexcept;
+
+    void update(const void *data, size_t bytes) noexcept;
+    uint64_t digest() const noexcept;
+
+private:
+    uint64_t seed;
+    uint64_t lanes[4];
+    unsigned char buffer[32];
+    size_t buffered = 0;
+    uint64_t total = 0;
+};
+
+// The source frames of an output frame: the processed planes of `src1`, all
+// planes of `src2` (nullptr for the internal guide) and `tag`, the frame
+// properties the output depends on.
+struct DpidCacheKey {
+    const VSFrame *src1, *src2;
+    bool process[3];
+    int tag;
+    uint64_t hash = 0; // set by DpidFrameCache::find() on a miss
+};
+
+struct DpidCacheEntry {
+    const VSAPI *vsapi;
+    const VSFrame *src1, *src2;
+    std::vector<const VSFrame *> dst; // one per output size
+    int tag;
+    uint64_t hash;
+    uint64_t last_use;
+
+    ~DpidCacheEntry();
+};
+
+// Output frames of the last `capacity` distinct source frames, for clips with
+// held or repeated frames.
+//
+// Sources are matched by their plane buffers first, which VapourSynth shares
+// between a frame and its repetitions, and by the hash of their content
+// otherwise. A match is only used when the content is equal byte for byte.
+// The least recently used entry is dropped when the cache is full.
+class DpidFrameCache {
+public:
+    DpidFrameCache(int capacity, const VSAPI *vsapi);
+
+    DpidFrameCache(const DpidFrameCache &) = delete;
+    DpidFrameCache &operator=(const DpidFrameCache &) = delete;
+
+    // the entry filtered from the same content as `key`, or nullptr
+    std::shared_ptr<const DpidCacheEntry> find(DpidCacheKey &key);
+
+    // adds the output frames of `key` after find() returned nullptr
+    void insert(const DpidCacheKey &key, const std::vector<VSFrame *> &dst, VSCore *core);
+
+private:
+    uint64_t hash(const DpidCacheKey &key) const;
+    bool sameBuffers(const DpidCacheEntry &entry, const DpidCacheKey &key) const;
+    bool sameContent(const DpidCacheEntry &entry, const DpidCacheKey &key) const;
+
+    const int capacity;
+    const VSAPI *vsapi;
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<DpidCacheEntry>> entries;
+    uint64_t clock = 0;
+};
+
+#endif // DPID_CACHE_H
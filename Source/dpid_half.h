@@ -0,0 +1,111 @@
+#ifndef DPID_HALF_H
+#define DPID_HALF_H
+
+// IEEE half precision sample of 16 bit float clips. It converts implicitly to
+// float and explicitly from it, so the templated passes handle it like a float
+// sample and do all arithmetic in float.
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define DPID_F16C 1
+#endif
+
+// Translation units compiled with F16C convert with the hardware instructions
+// and the others in software, so the definitions below differ between them.
+// Every translation unit gets its own copy of them and of DpidHalf on purpose:
+// with a named namespace the inline conversions and the members of DpidHalf,
+// which has external linkage there, would be one entity with several
+// definitions, and the linker could keep the F16C one for the C and SSE4.1
+// code. Unlike the static helpers of the other headers, a class can only have
+// internal linkage through an unnamed namespace.
+namespace {
+
+inline float dpidHalfToFloat(uint16_t h) noexcept {
+#ifdef DPID_F16C
+    return _cvtsh_ss(h);
+#else
+    // exponent and mantissa moved into place, then rebiased
+    const uint32_t shifted_exp = 0x7C00u << 13;
+    uint32_t bits = (h & 0x7FFFu) << 13;
+    const uint32_t exp = bits & shifted_exp;
+    bits += (127 - 15) << 23;
+
+    float f;
+    if (exp == shifted_exp) {
+        // inf and nan
+        bits += (128 - 16) << 23;
+        std::memcpy(&f, &bits, sizeof(f));
+    } else if (exp == 0) {
+        // zero and subnormals, renormalized by the float unit
+        bits += 1 << 23;
+        std::memcpy(&f, &bits, sizeof(f));
+        const uint32_t magic_bits = 113u << 23;
+        float magic;
+        std::memcpy(&magic, &magic_bits, sizeof(magic));
+        f -= magic;
+    } else {
+        std::memcpy(&f, &bits, sizeof(f));
+    }
+
+    uint32_t out;
+    std::memcpy(&out, &f, sizeof(out));
+    out |= static_cast<uint32_t>(h & 0x8000u) << 16;
+    std::memcpy(&f, &out, sizeof(f));
+    return f;
+#endif
+}
+
+// rounds to nearest even, like the hardware conversion
+inline uint16_t dpidFloatToHalf(float f) noexcept {
+#ifdef DPID_F16C
+    return static_cast<uint16_t>(_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT));
+#else
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+
+    const uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint16_t h;
+
+    if (bits >= (127u + 16) << 23) {
+        // overflow to inf, nan stays a quiet nan
+        h = bits > (255u << 23) ? 0x7E00 : 0x7C00;
+    } else if (bits < 113u << 23) {
+        // subnormal or zero: the float addition rounds the mantissa
+        const uint32_t magic_bits = ((127 - 15) + (23 - 10) + 1) << 23;
+        float magic, v;
+        std::memcpy(&magic, &magic_bits, sizeof(magic));
+        std::memcpy(&v, &bits, sizeof(v));
+        v += magic;
+        uint32_t v_bits;
+        std::memcpy(&v_bits, &v, sizeof(v_bits));
+        h = static_cast<uint16_t>(v_bits - magic_bits);
+    } else {
+        const uint32_t mant_odd = (bits >> 13) & 1;
+        bits += ((15u - 127u) << 23) + 0xFFF;
+        bits += mant_odd;
+        h = static_cast<uint16_t>(bits >> 13);
+    }
+
+    return static_cast<uint16_t>(h | (sign >> 16));
+#endif
+}
+
+struct DpidHalf {
+    uint16_t bits;
+
+    DpidHalf() noexcept = default;
+    explicit DpidHalf(float f) noexcept : bits(dpidFloatToHalf(f)) {}
+
+    operator float() const noexcept { return dpidHalfToFloat(bits); }
+};
+
+static_assert(sizeof(DpidHalf) == 2, "DpidHalf must match the layout of a 16 bit sample");
+
+} // namespace
+
+#endif // DPID_HALF_H
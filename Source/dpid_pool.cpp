@@ -0,0 +1,85 @@
+#include "dpid_pool.h"
+#include <algorithm>
+#include <atomic>
+
+
+struct DpidThreadPool::Batch {
+    const std::function<void(int)> *task;
+    int count;
+    std::atomic<int> next {0};
+    int users = 0; // workers holding a pointer to the batch, guarded by the pool mutex
+};
+
+DpidThreadPool::DpidThreadPool(int num_threads) {
+    for (int i = 1; i < num_threads; ++i)
+        workers.emplace_back(&DpidThreadPool::workerLoop, this);
+}
+
+DpidThreadPool::~DpidThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wakeup.notify_all();
+
+    for (auto &worker : workers)
+        worker.join();
+}
+
+void DpidThreadPool::work(Batch *batch) {
+    for (int i = batch->next++; i < batch->count; i = batch->next++)
+        (*batch->task)(i);
+}
+
+void DpidThreadPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wakeup.wait(lock, [this] { return stop || !queue.empty(); });
+        if (stop)
+            return;
+
+        Batch *batch = queue.front();
+        ++batch->users;
+        lock.unlock();
+
+        work(batch);
+
+        lock.lock();
+        // every task of the batch has been claimed, nobody needs to find it anymore
+        const auto it = std::find(queue.begin(), queue.end(), batch);
+        if (it != queue.end())
+            queue.erase(it);
+
+        if (--batch->users == 0)
+            idle.notify_all();
+    }
+}
+
+void DpidThreadPool::run(int count, const std::function<void(int)> &task) {
+    if (workers.empty() || count <= 1) {
+        for (int i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    Batch batch;
+    batch.task = &task;
+    batch.count = count;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(&batch);
+    }
+    wakeup.notify_all();
+
+    work(&batch);
+
+    // tasks claimed by workers are finished once they let go of the batch
+    std::unique_lock<std::mutex> lock(mutex);
+    const auto it = std::find(queue.begin(), queue.end(), &batch);
+    if (it != queue.end())
+        queue.erase(it);
+
+    idle.wait(lock, [&batch] { return batch.users == 0; });
+}
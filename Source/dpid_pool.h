@@ -0,0 +1,45 @@
+#ifndef DPID_POOL_H
+#define DPID_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Thread pool for splitting a single frame into tasks.
+//
+// run() publishes a batch of `count` tasks and lets the calling thread work on
+// it together with the workers; idle threads take the next unclaimed task of
+// the oldest unfinished batch, so frames requested concurrently share the
+// workers instead of queueing behind each other.
+class DpidThreadPool {
+public:
+    // `num_threads` includes the calling thread, so num_threads - 1 workers are started
+    explicit DpidThreadPool(int num_threads);
+    ~DpidThreadPool();
+
+    DpidThreadPool(const DpidThreadPool &) = delete;
+    DpidThreadPool &operator=(const DpidThreadPool &) = delete;
+
+    int size() const noexcept { return static_cast<int>(workers.size()) + 1; }
+
+    // calls task(0) ... task(count - 1) and returns when all of them have finished
+    void run(int count, const std::function<void(int)> &task);
+
+private:
+    struct Batch;
+
+    void workerLoop();
+    static void work(Batch *batch);
+
+    std::vector<std::thread> workers;
+    std::vector<Batch *> queue; // a few entries at most; keeps its capacity
+    std::mutex mutex;
+    std::condition_variable wakeup; // workers wait for batches
+    std::condition_variable idle;   // run() waits for its batch to be released
+    bool stop = false;
+};
+
+#endif // DPID_POOL_H
@@ -0,0 +1,62 @@
+#ifndef DPID_RESIZE_H
+#define DPID_RESIZE_H
+
+// Bilinear downscale producing the guide of Dpid from the source plane, with
+// the filter tables of DpidGeometry. The vertical pass runs first so that
+// source rows are read contiguously; the result stays in float.
+
+#include <cstddef>
+
+#include "dpid.h"
+
+namespace dpid_resize {
+
+template<typename T>
+static void bilinearPlane(const void * srcp_, int src_stride, float * downp, int down_stride, const DpidGeometry & geometry,
+    int y_begin, int y_end, DpidScratch & scratch) {
+
+    const T * srcp = static_cast<const T *>(srcp_);
+
+    const DpidFilter &fx = geometry.guide_x;
+    const DpidFilter &fy = geometry.guide_y;
+    const int src_w = geometry.x.src_size;
+    const int dst_w = geometry.x.dst_size;
+
+    float * row = scratch.get<float>(DPID_SCRATCH_ROWS, src_w);
+
+    for (int y = y_begin; y < y_end; ++y) {
+        const T * s = srcp + static_cast<ptrdiff_t>(fy.left[y]) * src_stride;
+        const float * cy = fy.coeffs.data() + static_cast<ptrdiff_t>(y) * fy.taps;
+
+        for (int x = 0; x < src_w; ++x)
+            row[x] = cy[0] * s[x];
+
+        for (int k = 1; k < fy.taps; ++k) {
+            s += src_stride;
+            for (int x = 0; x < src_w; ++x)
+                row[x] += cy[k] * s[x];
+        }
+
+        float * dst = downp + static_cast<ptrdiff_t>(y) * down_stride;
+
+        for (int x = 0; x < dst_w; ++x) {
+            const float * r = row + fx.left[x];
+            const float * cx = fx.coeffs.data() + static_cast<ptrdiff_t>(x) * fx.taps;
+
+            float sum {};
+            for (int k = 0; k < fx.taps; ++k)
+                sum += cx[k] * r[k];
+
+            dst[x] = sum;
+        }
+    }
+}
+
+template<typename T>
+static DpidResize getResize() noexcept {
+    return bilinearPlane<T>;
+}
+
+} // namespace dpid_resize
+
+#endif // DPID_RESIZE_H
@@ -0,0 +1,1093 @@
+#ifndef DPID_SIMD_H
+#define DPID_SIMD_H
+
+// Vectorized dpid kernel, included by one translation unit per instruction set.
+//
+// The including file provides a traits type `V` wrapping the intrinsics:
+// `V::f` (float vector), `V::i` (int32 vector), `V::m` (comparison mask) and
+// `V::width` lanes. Each vector processes `width` horizontally adjacent output
+// pixels; the accumulation order per pixel is the same as in the scalar
+// reference, only the general `pow` is evaluated with a polynomial approximation.
+// The guide plane passes from dpid_resize.h and dpid_blur.h are compiled once
+// per instruction set too.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "dpid.h"
+#include "dpid_blur.h"
+#include "dpid_half.h"
+#include "dpid_resize.h"
+
+namespace dpid_simd {
+
+template<typename V, typename T>
+static inline void convertRow(const T * src, float * dst, int w) {
+    if constexpr (std::is_same_v<T, float>) {
+        std::memcpy(dst, src, w * sizeof(float));
+    } else if constexpr (std::is_same_v<T, DpidHalf>) {
+        int x = 0;
+        for (; x + V::width <= w; x += V::width)
+            V::storeu(dst + x, V::loadh(&src[x].bits));
+        for (; x < w; ++x)
+            dst[x] = src[x];
+    } else {
+        for (int x = 0; x < w; ++x)
+            dst[x] = static_cast<float>(src[x]);
+    }
+}
+
+// natural logarithm for positive normal inputs (cephes logf)
+template<typename V>
+static inline typename V::f log(typename V::f x) {
+    using f = typename V::f;
+    using i = typename V::i;
+
+    const i xi = V::castfi(x);
+    f e = V::cvt(V::isub(V::isrl23(xi), V::iset1(127)));
+    f m = V::castif(V::ior(V::iand(xi, V::iset1(0x007FFFFF)), V::iset1(0x3F800000)));
+
+    // m in [sqrt(0.5), sqrt(2))
+    const auto big = V::gt(m, V::set1(1.41421356f));
+    m = V::select(big, V::mul(m, V::set1(0.5f)), m);
+    e = V::select(big, V::add(e, V::set1(1.0f)), e);
+
+    const f t = V::sub(m, V::set1(1.0f));
+    const f z = V::mul(t, t);
+
+    f y = V::set1(7.0376836292e-2f);
+    y = V::add(V::mul(y, t), V::set1(-1.1514610310e-1f));
+    y = V::add(V::mul(y, t), V::set1(1.1676998740e-1f));
+    y = V::add(V::mul(y, t), V::set1(-1.2420140846e-1f));
+    y = V::add(V::mul(y, t), V::set1(1.4249322787e-1f));
+    y = V::add(V::mul(y, t), V::set1(-1.6668057665e-1f));
+    y = V::add(V::mul(y, t), V::set1(2.0000714765e-1f));
+    y = V::add(V::mul(y, t), V::set1(-2.4999993993e-1f));
+    y = V::add(V::mul(y, t), V::set1(3.3333331174e-1f));
+    y = V::mul(V::mul(y, t), z);
+
+    y = V::add(y, V::mul(e, V::set1(-2.12194440e-4f)));
+    y = V::sub(y, V::mul(z, V::set1(0.5f)));
+
+    return V::add(V::add(t, y), V::mul(e, V::set1(0.693359375f)));
+}
+
+// e^x (cephes expf), saturates instead of overflowing
+template<typename V>
+static inline typename V::f exp(typename V::f x) {
+    using f = typename V::f;
+
+    x = V::min(V::max(x, V::set1(-87.3f)), V::set1(88.0f));
+
+    const f fx = V::floor(V::add(V::mul(x, V::set1(1.44269504088896341f)), V::set1(0.5f)));
+    x = V::sub(x, V::mul(fx, V::set1(0.693359375f)));
+    x = V::sub(x, V::mul(fx, V::set1(-2.12194440e-4f)));
+
+    const f z = V::mul(x, x);
+
+    f y = V::set1(1.9875691500e-4f);
+    y = V::add(V::mul(y, x), V::set1(1.3981999507e-3f));
+    y = V::add(V::mul(y, x), V::set1(8.3334519073e-3f));
+    y = V::add(V::mul(y, x), V::set1(4.1665795894e-2f));
+    y = V::add(V::mul(y, x), V::set1(1.6666665459e-1f));
+    y = V::add(V::mul(y, x), V::set1(5.0000001201e-1f));
+    y = V::add(V::add(V::mul(y, z), x), V::set1(1.0f));
+
+    const f pow2n = V::castif(V::isll23(V::iadd(V::cvtt(fx), V::iset1(127))));
+
+    return V::mul(y, pow2n);
+}
+
+// x^lambda for x >= 0, with pow(0, lambda) supplied by the caller
+template<typename V>
+static inline typename V::f pow(typename V::f x, typename V::f lambda, typename V::f pow0) {
+    const auto tiny = V::lt(x, V::set1(1.17549435e-38f));
+    const typename V::f r = exp<V>(V::mul(lambda, log<V>(V::max(x, V::set1(1.17549435e-38f)))));
+    return V::select(tiny, pow0, r);
+}
+
+// log2(x) of dpidFastPow for normal x
+template<typename V>
+static inline typename V::f fastLog2(typename V::f x) {
+    using f = typename V::f;
+
+    // mantissa in [sqrt(0.5), sqrt(2)) like dpidFastPow
+    const typename V::i xi = V::iadd(V::castfi(x), V::iset1(0x3F800000 - 0x3F3504F3));
+    const f e = V::cvt(V::isub(V::isrl23(xi), V::iset1(127)));
+    const f m = V::castif(V::iadd(V::iand(xi, V::iset1(0x007FFFFF)), V::iset1(0x3F3504F3)));
+
+    const f t = V::sub(m, V::set1(1.0f));
+    f p = V::set1(dpidFastLog2[0]);
+    for (int i = 1; i < 6; ++i)
+        p = V::add(V::mul(p, t), V::set1(dpidFastLog2[i]));
+
+    return V::add(e, V::mul(p, t));
+}
+
+// 2^y of dpidFastPow
+template<typename V>
+static inline typename V::f fastExp2(typename V::f y) {
+    using f = typename V::f;
+
+    y = V::min(V::max(y, V::set1(-126.0f)), V::set1(127.0f));
+    const typename V::i n = V::isub(V::cvtt(V::add(y, V::set1(126.5f))), V::iset1(126));
+    const f fr = V::sub(y, V::cvt(n));
+
+    f r = V::set1(dpidFastExp2[0]);
+    for (int i = 1; i < 5; ++i)
+        r = V::add(V::mul(r, fr), V::set1(dpidFastExp2[i]));
+
+    const f scale = V::castif(V::isll23(V::iadd(n, V::iset1(127))));
+
+    return V::mul(r, scale);
+}
+
+// dpidFastPow: exp2(lambda * log2(x)) with short polynomials
+template<typename V>
+static inline typename V::f fastPow(typename V::f x, typename V::f lambda, typename V::f pow0) {
+    const auto tiny = V::lt(x, V::set1(1.17549435e-38f));
+    return V::select(tiny, pow0, fastExp2<V>(V::mul(lambda, fastLog2<V>(x))));
+}
+
+// parameters of the range kernel
+template<typename V>
+struct Range {
+    typename V::f lambda, pow0;
+    const float * table;             // DpidLut::table
+    typename V::f scale, table_max;  // DpidLut::scale, last valid index
+};
+
+template<typename V, int Lambda>
+static inline typename V::f rangeKernel(typename V::f avg, typename V::f pixel, const Range<V> & range) {
+    using f = typename V::f;
+
+    const f distance = V::abs(V::sub(avg, pixel));
+
+    if constexpr (Lambda == DPID_LAMBDA_0) {
+        return V::set1(1.0f);
+    } else if constexpr (Lambda == DPID_LAMBDA_0_5) {
+        return V::sqrt(distance);
+    } else if constexpr (Lambda == DPID_LAMBDA_1) {
+        return distance;
+    } else if constexpr (Lambda == DPID_LAMBDA_2) {
+        return V::mul(distance, distance);
+    } else if constexpr (Lambda == DPID_LAMBDA_LUT) {
+        // same rounding of avg and clamp as the scalar reference; the clamp is
+        // for samples above the bit depth and lanes past the end of the row
+        const f avg_q = V::floor(V::add(V::mul(avg, V::set1(16.0f)), V::set1(0.5f)));
+        const f pos = V::min(V::abs(V::sub(avg_q, V::mul(pixel, V::set1(16.0f)))), range.table_max);
+        return V::gather(range.table, V::cvtt(pos));
+    } else if constexpr (Lambda == DPID_LAMBDA_LUT_LERP) {
+        const f pos = V::min(V::mul(distance, range.scale), range.table_max);
+        const f pos_i = V::floor(pos);
+        const typename V::i idx = V::cvtt(pos_i);
+        const f w0 = V::gather(range.table, idx);
+        const f w1 = V::gather(range.table + 1, idx);
+        return V::add(w0, V::mul(V::sub(pos, pos_i), V::sub(w1, w0)));
+    } else if constexpr (Lambda == DPID_LAMBDA_FAST) {
+        return fastPow<V>(distance, range.lambda, range.pow0);
+    } else {
+        return pow<V>(distance, range.lambda, range.pow0);
+    }
+}
+
+// Lambda of the kernels that read their weights from the map of
+// shared_weights instead of computing them
+constexpr int shared_lambda = -1;
+
+// Accumulates one source row into the sums of `width` output pixels.
+// Aligned footprints carry no partial coverage; Masked is false when every lane
+// covers exactly `max_count` pixels. `weights` is the row of the weight map
+// with shared_lambda and unused otherwise.
+template<typename V, int Lambda, bool Aligned, bool Masked>
+static inline void accumulateRow(const float * row, const float * weights, int max_count,
+    typename V::f avg, typename V::f begin, typename V::f count, typename V::f first, typename V::f last,
+    typename V::f coverage_y, const Range<V> & range,
+    typename V::f & sum_pixel, typename V::f & sum_weight) {
+
+    using f = typename V::f;
+
+    const f one_v = V::set1(1.0f);
+    const f last_k = V::sub(count, one_v);
+
+    for (int k = 0; k < max_count; ++k) {
+        const f k_v = V::set1(static_cast<float>(k));
+        const typename V::i index = V::cvtt(V::add(begin, k_v));
+        const f pixel = V::gather(row, index);
+
+        f weight;
+        if constexpr (Lambda == shared_lambda)
+            weight = V::gather(weights, index);
+        else
+            weight = rangeKernel<V, Lambda>(avg, pixel, range);
+
+        if constexpr (!Aligned) {
+            f coverage = (k == 0) ? first : one_v;
+            coverage = V::mul(coverage, V::select(V::eq(k_v, last_k), last, one_v));
+            weight = V::mul(weight, V::mul(coverage, coverage_y));
+        }
+
+        if constexpr (Masked)
+            weight = V::select(V::lt(k_v, count), weight, V::zero());
+
+        sum_pixel = V::add(sum_pixel, V::mul(weight, pixel));
+        sum_weight = V::add(sum_weight, weight);
+    }
+}
+
+// Footprint widths of the `width` output pixels starting at one column; the
+// same for every output row.
+struct Columns {
+    int num_k;   // widest footprint
+    bool masked; // the footprints differ in width
+};
+
+// one Columns per vector of output pixels, stored in `columns`
+template<typename V>
+static void makeColumns(const DpidAxis &gx, Columns * columns) {
+    constexpr int W = V::width;
+
+    for (int outer_x = 0; outer_x < gx.dst_size; outer_x += W) {
+        int min_count = gx.end[outer_x] - gx.begin[outer_x];
+        int max_count = min_count;
+
+        // lanes past dst_size have empty footprints, like the vector loads see them
+        for (int j = 1; j < W; ++j) {
+            const int count = gx.end[outer_x + j] - gx.begin[outer_x + j];
+            min_count = std::min(min_count, count);
+            max_count = std::max(max_count, count);
+        }
+
+        columns[outer_x / W] = {max_count, min_count != max_count};
+    }
+}
+
+// Accumulates one source row into the sums of the output pixels starting at
+// column `outer_x`.
+template<typename V, int Lambda, bool Aligned>
+static inline void accumulateColumns(const float * row, const float * weights, const DpidAxis & gx, int outer_x, const Columns & columns,
+    typename V::f avg, typename V::f coverage_y, const Range<V> & range,
+    typename V::f & sum_pixel, typename V::f & sum_weight) {
+
+    const typename V::i begin_i = V::iloadu(gx.begin.data() + outer_x);
+    const typename V::f begin = V::cvt(begin_i);
+    const typename V::f count = V::cvt(V::isub(V::iloadu(gx.end.data() + outer_x), begin_i));
+    const typename V::f first = V::loadu(gx.first.data() + outer_x);
+    const typename V::f last = V::loadu(gx.last.data() + outer_x);
+
+    if (columns.masked)
+        accumulateRow<V, Lambda, Aligned, true>(row, weights, columns.num_k, avg, begin, count, first, last,
+            coverage_y, range, sum_pixel, sum_weight);
+    else
+        accumulateRow<V, Lambda, Aligned, false>(row, weights, columns.num_k, avg, begin, count, first, last,
+            coverage_y, range, sum_pixel, sum_weight);
+}
+
+// Stores the `n` <= width output pixels starting at `dst`.
+template<typename V, typename T>
+static inline void storePixels(T * dst, int n, typename V::f avg, typename V::f sum_pixel, typename V::f sum_weight) {
+    const typename V::f result = V::select(V::eq(sum_weight, V::zero()), avg, V::div(sum_pixel, sum_weight));
+
+    if constexpr (std::is_same_v<T, DpidHalf>) {
+        if (n == V::width) {
+            V::storeh(&dst[0].bits, result);
+            return;
+        }
+    }
+
+    alignas(64) float out[V::width];
+    V::store(out, result);
+    for (int j = 0; j < n; ++j)
+        dst[j] = static_cast<T>(out[j]);
+}
+
+// Size of the converted source rows of one output row above which the kernel
+// accumulates row by row, so that the working set stays in L2 with large
+// scaling factors. Both orders give the same result; below it, keeping the
+// sums in registers is a bit cheaper.
+constexpr size_t stream_bytes = 128 * 1024;
+
+// DpidKernel, and DpidSharedKernel with shared_lambda, whose rows of the
+// weight map are copied next to the converted source rows
+template<typename V, typename T, int Lambda, bool Aligned>
+static void process(const void *srcp_, int src_stride,
+    const float *avgp, int avg_stride,
+    const float *weightp, int weight_stride,
+    void *dstp_, int dst_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch) {
+
+    using f = typename V::f;
+    constexpr int W = V::width;
+    // the source rows, and the rows of the weight map
+    constexpr int num_bands = Lambda == shared_lambda ? 2 : 1;
+
+    const T * srcp = static_cast<const T *>(srcp_);
+    T * dstp = static_cast<T *>(dstp_);
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int src_w = gx.src_size;
+    const int dst_w = gx.dst_size;
+
+    int max_cols = 0;
+    for (int i = 0; i < dst_w; ++i)
+        max_cols = std::max(max_cols, gx.end[i] - gx.begin[i]);
+
+    int max_rows = 0;
+    for (int i = y_begin; i < y_end; ++i)
+        max_rows = std::max(max_rows, gy.end[i] - gy.begin[i]);
+
+    // reads through masked lanes stay inside the zeroed padding
+    const int band_stride = (src_w + max_cols + W - 1) / W * W;
+    const int num_columns = (dst_w + W - 1) / W;
+
+    Columns * columns = scratch.get<Columns>(DPID_SCRATCH_COLUMNS, num_columns);
+    makeColumns<V>(gx, columns);
+
+    Range<V> range;
+    range.lambda = V::set1(lambda);
+    range.pow0 = V::set1(std::pow(0.0f, lambda));
+    range.table = lut ? lut->table.data() : nullptr;
+    range.scale = V::set1(lut ? lut->scale : 0.0f);
+    // the interpolated table reads one entry past the index
+    range.table_max = V::set1(lut ? static_cast<float>(lut->table.size() - 2) : 0.0f);
+
+    const f zero_v = V::zero();
+
+    if (static_cast<size_t>(band_stride) * max_rows * num_bands * sizeof(float) > stream_bytes) {
+        // Every source row is converted and read once, from left to right,
+        // while the sums of the output row wait in memory. The sums of a pixel
+        // are accumulated in the same order as below.
+        float * row = scratch.get<float>(DPID_SCRATCH_ROWS, static_cast<size_t>(band_stride) * num_bands);
+        float * weights = row + band_stride;
+        float * sums = scratch.get<float>(DPID_SCRATCH_SUMS, static_cast<size_t>(num_columns) * W * 2);
+
+        for (int i = 0; i < num_bands; ++i)
+            std::fill(row + static_cast<ptrdiff_t>(i) * band_stride + src_w, row + static_cast<ptrdiff_t>(i + 1) * band_stride, 0.0f);
+
+        for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+            const float * avg_row = avgp + static_cast<ptrdiff_t>(outer_y) * avg_stride;
+
+            std::fill(sums, sums + static_cast<size_t>(num_columns) * W * 2, 0.0f);
+
+            for (int inner_y = gy.begin[outer_y]; inner_y < gy.end[outer_y]; ++inner_y) {
+                convertRow<V>(srcp + static_cast<ptrdiff_t>(inner_y) * src_stride, row, src_w);
+                if constexpr (Lambda == shared_lambda)
+                    std::memcpy(weights, weightp + static_cast<ptrdiff_t>(inner_y) * weight_stride, src_w * sizeof(float));
+
+                const f coverage_y = V::set1(Aligned ? 1.0f : dpidCoverage(gy, outer_y, inner_y));
+
+                float * sum = sums;
+
+                for (int outer_x = 0; outer_x < dst_w; outer_x += W, sum += W * 2) {
+                    f sum_pixel = V::load(sum);
+                    f sum_weight = V::load(sum + W);
+
+                    accumulateColumns<V, Lambda, Aligned>(row, weights, gx, outer_x, columns[outer_x / W],
+                        V::loadu(avg_row + outer_x), coverage_y, range, sum_pixel, sum_weight);
+
+                    V::store(sum, sum_pixel);
+                    V::store(sum + W, sum_weight);
+                }
+            }
+
+            const float * sum = sums;
+
+            for (int outer_x = 0; outer_x < dst_w; outer_x += W, sum += W * 2)
+                storePixels<V>(dstp + static_cast<ptrdiff_t>(outer_y) * dst_stride + outer_x, std::min(W, dst_w - outer_x),
+                    V::loadu(avg_row + outer_x), V::load(sum), V::load(sum + W));
+        }
+
+        return;
+    }
+
+    const ptrdiff_t weights_offset = static_cast<ptrdiff_t>(band_stride) * max_rows;
+    float * band = scratch.get<float>(DPID_SCRATCH_ROWS, static_cast<size_t>(weights_offset) * num_bands);
+
+    for (int i = 0; i < max_rows * num_bands; ++i)
+        std::fill(band + static_cast<ptrdiff_t>(i) * band_stride + src_w, band + static_cast<ptrdiff_t>(i + 1) * band_stride, 0.0f);
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+
+        const int syr = gy.begin[outer_y];
+        const int eyr = gy.end[outer_y];
+
+        for (int inner_y = syr; inner_y < eyr; ++inner_y) {
+            convertRow<V>(srcp + static_cast<ptrdiff_t>(inner_y) * src_stride,
+                band + static_cast<ptrdiff_t>(inner_y - syr) * band_stride, src_w);
+
+            if constexpr (Lambda == shared_lambda)
+                std::memcpy(band + weights_offset + static_cast<ptrdiff_t>(inner_y - syr) * band_stride,
+                    weightp + static_cast<ptrdiff_t>(inner_y) * weight_stride, src_w * sizeof(float));
+        }
+
+        for (int outer_x = 0; outer_x < dst_w; outer_x += W) {
+            const f avg = V::loadu(avgp + static_cast<ptrdiff_t>(outer_y) * avg_stride + outer_x);
+
+            f sum_pixel = zero_v;
+            f sum_weight = zero_v;
+
+            for (int inner_y = syr; inner_y < eyr; ++inner_y) {
+                const float * row = band + static_cast<ptrdiff_t>(inner_y - syr) * band_stride;
+                const f coverage_y = V::set1(Aligned ? 1.0f : dpidCoverage(gy, outer_y, inner_y));
+
+                accumulateColumns<V, Lambda, Aligned>(row, row + weights_offset, gx, outer_x, columns[outer_x / W],
+                    avg, coverage_y, range, sum_pixel, sum_weight);
+            }
+
+            storePixels<V>(dstp + static_cast<ptrdiff_t>(outer_y) * dst_stride + outer_x, std::min(W, dst_w - outer_x),
+                avg, sum_pixel, sum_weight);
+        }
+    }
+}
+
+template<typename V, typename T, int Lambda, bool Aligned>
+static void dpidProcess(const void *srcp, int src_stride,
+    const float *avgp, int avg_stride,
+    void *dstp, int dst_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch) {
+
+    process<V, T, Lambda, Aligned>(srcp, src_stride, avgp, avg_stride, nullptr, 0,
+        dstp, dst_stride, geometry, lambda, lut, y_begin, y_end, scratch);
+}
+
+template<typename V, typename T, bool Aligned>
+static void dpidProcessShared(const void *srcp, int src_stride,
+    const float *avgp, int avg_stride,
+    const float *weightp, int weight_stride,
+    void *dstp, int dst_stride,
+    const DpidGeometry &geometry, int y_begin, int y_end, DpidScratch &scratch) {
+
+    process<V, T, shared_lambda, Aligned>(srcp, src_stride, avgp, avg_stride, weightp, weight_stride,
+        dstp, dst_stride, geometry, 0.0f, nullptr, y_begin, y_end, scratch);
+}
+
+// dpidProcess through the histogram of each footprint, see
+// dpidGetHistogramKernel. The footprint is read like in the scalar kernel;
+// the range kernel runs on `width` distinct values at once.
+template<typename V, typename T, int Lambda, bool Aligned>
+static void dpidProcessHistogram(const void *srcp_, int src_stride,
+    const float *avgp, int avg_stride,
+    void *dstp_, int dst_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch) {
+
+    using f = typename V::f;
+    constexpr int W = V::width;
+
+    const T * srcp = static_cast<const T *>(srcp_);
+    T * dstp = static_cast<T *>(dstp_);
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int dst_w = gx.dst_size;
+
+    int max_cols = 0;
+    for (int i = 0; i < dst_w; ++i)
+        max_cols = std::max(max_cols, gx.end[i] - gx.begin[i]);
+
+    int max_rows = 0;
+    for (int i = y_begin; i < y_end; ++i)
+        max_rows = std::max(max_rows, gy.end[i] - gy.begin[i]);
+
+    // One more value than T holds pads the last vector of bins; it never gets
+    // coverage, so its weight is zero. The coverage of the other values is
+    // zero again after every output pixel.
+    constexpr int num_values = 1 << (8 * sizeof(T));
+    float * hist = scratch.get<float>(DPID_SCRATCH_HISTOGRAM, num_values + 1);
+    int * bins = scratch.get<int>(DPID_SCRATCH_ROWS, static_cast<size_t>(max_cols) * max_rows + W);
+    std::fill(hist, hist + num_values + 1, 0.0f);
+
+    Range<V> range;
+    range.lambda = V::set1(lambda);
+    range.pow0 = V::set1(std::pow(0.0f, lambda));
+    range.table = lut ? lut->table.data() : nullptr;
+    range.scale = V::set1(lut ? lut->scale : 0.0f);
+    range.table_max = V::set1(lut ? static_cast<float>(lut->table.size() - 2) : 0.0f);
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+            const float avg = avgp[static_cast<ptrdiff_t>(outer_y) * avg_stride + outer_x];
+            const f avg_v = V::set1(avg);
+
+            const int num_bins = dpidFillHistogram<T, Aligned>(srcp, src_stride, geometry, outer_x, outer_y, hist, bins);
+            std::fill(bins + num_bins, bins + num_bins + W, num_values);
+
+            f sum_pixel = V::zero();
+            f sum_weight = V::zero();
+
+            for (int i = 0; i < num_bins; i += W) {
+                const typename V::i index = V::iloadu(bins + i);
+                const f value = V::cvt(index);
+                const f weight = V::mul(rangeKernel<V, Lambda>(avg_v, value, range), V::gather(hist, index));
+
+                sum_pixel = V::add(sum_pixel, V::mul(weight, value));
+                sum_weight = V::add(sum_weight, weight);
+            }
+
+            for (int i = 0; i < num_bins; ++i)
+                hist[bins[i]] = 0.0f;
+
+            alignas(64) float pixel_lanes[W];
+            alignas(64) float weight_lanes[W];
+            V::store(pixel_lanes, sum_pixel);
+            V::store(weight_lanes, sum_weight);
+
+            float pixel_sum {};
+            float weight_sum {};
+            for (int j = 0; j < W; ++j) {
+                pixel_sum += pixel_lanes[j];
+                weight_sum += weight_lanes[j];
+            }
+
+            dstp[static_cast<ptrdiff_t>(outer_y) * dst_stride + outer_x] =
+                static_cast<T>((weight_sum == 0.f) ? avg : pixel_sum / weight_sum);
+        }
+    }
+}
+
+// DpidWeights. Every vector covers `width` source pixels of a row and
+// gathers the guide values of their owners from the guide row of the output
+// row that owns the source row.
+template<typename V, typename T, int Lambda>
+static void dpidWeights(const DpidGuidePlane *planes, int num_planes, int avg_stride,
+    const DpidGeometry &geometry, float lambda, const DpidLut *lut,
+    float *weightp, int weight_stride, int y_begin, int y_end, DpidScratch &scratch) {
+
+    using f = typename V::f;
+    constexpr int W = V::width;
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int src_w = gx.src_size;
+    const int dst_w = gx.dst_size;
+    const int row_stride = (src_w + W - 1) / W * W;
+
+    // the converted row of one plane and the guide row
+    float * row = scratch.get<float>(DPID_SCRATCH_ROWS, static_cast<size_t>(row_stride) * 2);
+    float * guide = row + row_stride;
+    float * avg = scratch.get<float>(DPID_SCRATCH_SUMS, dpidAvgStride(dst_w));
+
+    Range<V> range;
+    range.lambda = V::set1(lambda);
+    range.pow0 = V::set1(std::pow(0.0f, lambda));
+    range.table = lut ? lut->table.data() : nullptr;
+    range.scale = V::set1(lut ? lut->scale : 0.0f);
+    range.table_max = V::set1(lut ? static_cast<float>(lut->table.size() - 2) : 0.0f);
+
+    std::fill(row + src_w, row + row_stride, 0.0f);
+
+    int row_begin, row_end;
+    dpidOwnedRange(gy, y_begin, y_end, row_begin, row_end);
+
+    for (int inner_y = row_begin; inner_y < row_end; ++inner_y) {
+        const int outer_y = gy.owner[inner_y];
+
+        for (int outer_x = 0; outer_x < dst_w; outer_x += W) {
+            f sum = V::zero();
+            for (int j = 0; j < num_planes; ++j)
+                sum = V::add(sum, V::mul(V::set1(planes[j].weight),
+                    V::loadu(planes[j].avgp + static_cast<ptrdiff_t>(outer_y) * avg_stride + outer_x)));
+            V::store(avg + outer_x, sum);
+        }
+
+        for (int j = 0; j < num_planes; ++j) {
+            convertRow<V>(static_cast<const T *>(planes[j].srcp) + static_cast<ptrdiff_t>(inner_y) * planes[j].src_stride, row, src_w);
+
+            const f weight = V::set1(planes[j].weight);
+
+            for (int inner_x = 0; inner_x < src_w; inner_x += W) {
+                const f sum = j == 0 ? V::zero() : V::load(guide + inner_x);
+                V::store(guide + inner_x, V::add(sum, V::mul(weight, V::load(row + inner_x))));
+            }
+        }
+
+        float * dst = weightp + static_cast<ptrdiff_t>(inner_y) * weight_stride;
+
+        for (int inner_x = 0; inner_x < src_w; inner_x += W) {
+            const f avg_v = V::gather(avg, V::iloadu(gx.owner.data() + inner_x));
+            V::storeu(dst + inner_x, rangeKernel<V, Lambda>(avg_v, V::load(guide + inner_x), range));
+        }
+    }
+}
+
+// parameters of the range kernels of DpidSweepKernel
+template<typename V>
+struct Sweep {
+    int num_lambda;
+    int lambda_class[DPID_SWEEP_MAX];
+    typename V::f lambda[DPID_SWEEP_MAX], pow0[DPID_SWEEP_MAX];
+    bool general; // some value needs the general pow
+};
+
+// accumulateRow for several lambda values. The distance, the coverage and the
+// logarithm of pow are computed once per pixel; the weights are the same as
+// the ones of rangeKernel.
+template<typename V, bool Aligned, bool Masked, bool Fast>
+static inline void accumulateSweepRow(const float * row, int max_count,
+    typename V::f avg, typename V::f begin, typename V::f count, typename V::f first, typename V::f last,
+    typename V::f coverage_y, const Sweep<V> & sweep,
+    typename V::f * sum_pixel, typename V::f * sum_weight) {
+
+    using f = typename V::f;
+
+    const f one_v = V::set1(1.0f);
+    const f tiny_v = V::set1(1.17549435e-38f);
+    const f last_k = V::sub(count, one_v);
+
+    for (int k = 0; k < max_count; ++k) {
+        const f k_v = V::set1(static_cast<float>(k));
+        const f pixel = V::gather(row, V::cvtt(V::add(begin, k_v)));
+        const f distance = V::abs(V::sub(avg, pixel));
+
+        f coverage = one_v;
+        if constexpr (!Aligned) {
+            coverage = (k == 0) ? first : one_v;
+            coverage = V::mul(coverage, V::select(V::eq(k_v, last_k), last, one_v));
+            coverage = V::mul(coverage, coverage_y);
+        }
+
+        const auto tiny = V::lt(distance, tiny_v);
+        f log_x = V::zero();
+        if (sweep.general)
+            log_x = Fast ? fastLog2<V>(distance) : log<V>(V::max(distance, tiny_v));
+
+        for (int j = 0; j < sweep.num_lambda; ++j) {
+            f weight;
+
+            switch (sweep.lambda_class[j]) {
+            case DPID_LAMBDA_0:
+                weight = one_v;
+                break;
+            case DPID_LAMBDA_0_5:
+                weight = V::sqrt(distance);
+                break;
+            case DPID_LAMBDA_1:
+                weight = distance;
+                break;
+            case DPID_LAMBDA_2:
+                weight = V::mul(distance, distance);
+                break;
+            default:
+                weight = V::select(tiny, sweep.pow0[j],
+                    Fast ? fastExp2<V>(V::mul(sweep.lambda[j], log_x)) : exp<V>(V::mul(sweep.lambda[j], log_x)));
+                break;
+            }
+
+            if constexpr (!Aligned)
+                weight = V::mul(weight, coverage);
+
+            if constexpr (Masked)
+                weight = V::select(V::lt(k_v, count), weight, V::zero());
+
+            sum_pixel[j] = V::add(sum_pixel[j], V::mul(weight, pixel));
+            sum_weight[j] = V::add(sum_weight[j], weight);
+        }
+    }
+}
+
+// dpidProcess for several lambda values, with the rows of an output row
+// converted together like there
+template<typename V, typename T, bool Aligned, bool Fast>
+static void dpidProcessSweep(const void *srcp_, int src_stride,
+    const float *avgp, int avg_stride,
+    void *const *dstp, int dst_stride,
+    const DpidGeometry &geometry, const float *lambda, int num_lambda, int y_begin, int y_end, DpidScratch &scratch) {
+
+    using f = typename V::f;
+    constexpr int W = V::width;
+
+    const T * srcp = static_cast<const T *>(srcp_);
+
+    const DpidAxis &gx = geometry.x;
+    const DpidAxis &gy = geometry.y;
+    const int src_w = gx.src_size;
+    const int dst_w = gx.dst_size;
+
+    int max_cols = 0;
+    for (int i = 0; i < dst_w; ++i)
+        max_cols = std::max(max_cols, gx.end[i] - gx.begin[i]);
+
+    int max_rows = 0;
+    for (int i = y_begin; i < y_end; ++i)
+        max_rows = std::max(max_rows, gy.end[i] - gy.begin[i]);
+
+    const int band_stride = (src_w + max_cols + W - 1) / W * W;
+    const int num_columns = (dst_w + W - 1) / W;
+
+    Columns * columns = scratch.get<Columns>(DPID_SCRATCH_COLUMNS, num_columns);
+    makeColumns<V>(gx, columns);
+
+    Sweep<V> sweep;
+    sweep.num_lambda = num_lambda;
+    sweep.general = false;
+
+    for (int j = 0; j < num_lambda; ++j) {
+        sweep.lambda_class[j] = dpidLambdaClass(lambda[j]);
+        sweep.lambda[j] = V::set1(lambda[j]);
+        sweep.pow0[j] = V::set1(std::pow(0.0f, lambda[j]));
+        sweep.general = sweep.general || sweep.lambda_class[j] == DPID_LAMBDA_ANY;
+    }
+
+    float * band = scratch.get<float>(DPID_SCRATCH_ROWS, static_cast<size_t>(band_stride) * max_rows);
+
+    for (int i = 0; i < max_rows; ++i)
+        std::fill(band + static_cast<ptrdiff_t>(i) * band_stride + src_w, band + static_cast<ptrdiff_t>(i + 1) * band_stride, 0.0f);
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+
+        const int syr = gy.begin[outer_y];
+        const int eyr = gy.end[outer_y];
+
+        for (int inner_y = syr; inner_y < eyr; ++inner_y)
+            convertRow<V>(srcp + static_cast<ptrdiff_t>(inner_y) * src_stride,
+                band + static_cast<ptrdiff_t>(inner_y - syr) * band_stride, src_w);
+
+        for (int outer_x = 0; outer_x < dst_w; outer_x += W) {
+            const f avg = V::loadu(avgp + static_cast<ptrdiff_t>(outer_y) * avg_stride + outer_x);
+
+            f sum_pixel[DPID_SWEEP_MAX];
+            f sum_weight[DPID_SWEEP_MAX];
+
+            for (int j = 0; j < num_lambda; ++j) {
+                sum_pixel[j] = V::zero();
+                sum_weight[j] = V::zero();
+            }
+
+            const Columns & column = columns[outer_x / W];
+            const typename V::i begin_i = V::iloadu(gx.begin.data() + outer_x);
+            const f begin = V::cvt(begin_i);
+            const f count = V::cvt(V::isub(V::iloadu(gx.end.data() + outer_x), begin_i));
+            const f first = V::loadu(gx.first.data() + outer_x);
+            const f last = V::loadu(gx.last.data() + outer_x);
+
+            for (int inner_y = syr; inner_y < eyr; ++inner_y) {
+                const float * row = band + static_cast<ptrdiff_t>(inner_y - syr) * band_stride;
+                const f coverage_y = V::set1(Aligned ? 1.0f : dpidCoverage(gy, outer_y, inner_y));
+
+                if (column.masked)
+                    accumulateSweepRow<V, Aligned, true, Fast>(row, column.num_k, avg, begin, count, first, last,
+                        coverage_y, sweep, sum_pixel, sum_weight);
+                else
+                    accumulateSweepRow<V, Aligned, false, Fast>(row, column.num_k, avg, begin, count, first, last,
+                        coverage_y, sweep, sum_pixel, sum_weight);
+            }
+
+            for (int j = 0; j < num_lambda; ++j)
+                storePixels<V>(static_cast<T *>(dstp[j]) + static_cast<ptrdiff_t>(outer_y) * dst_stride + outer_x,
+                    std::min(W, dst_w - outer_x), avg, sum_pixel[j], sum_weight[j]);
+        }
+    }
+}
+
+// DpidReduce. The rows of a block are converted together and every vector
+// covers `width` source columns, so the block sums are added up per column
+// first and per block at the end; they differ from the scalar reference by
+// rounding only.
+template<typename V, typename T, int Lambda>
+static void dpidReduce(const void *srcp_, int src_stride, int src_w, int src_h,
+    float *dstp, int dst_stride, int factor, float lambda, const DpidLut *lut, int y_begin, int y_end, DpidScratch &scratch) {
+
+    using f = typename V::f;
+    constexpr int W = V::width;
+
+    const T * srcp = static_cast<const T *>(srcp_);
+
+    const int dst_w = dpidReducedSize(src_w, factor);
+    const int row_stride = (src_w + W - 1) / W * W;
+
+    float * band = scratch.get<float>(DPID_SCRATCH_ROWS, static_cast<size_t>(row_stride) * factor);
+    // column sums, then the sums of the weighted mean, and the block means
+    // repeated for every column
+    float * sums = scratch.get<float>(DPID_SCRATCH_SUMS, static_cast<size_t>(row_stride) * 3);
+    float * sum_pixel = sums;
+    float * sum_weight = sums + row_stride;
+    float * avg_row = sums + static_cast<ptrdiff_t>(row_stride) * 2;
+
+    Range<V> range;
+    range.lambda = V::set1(lambda);
+    range.pow0 = V::set1(std::pow(0.0f, lambda));
+    range.table = lut ? lut->table.data() : nullptr;
+    range.scale = V::set1(lut ? lut->scale : 0.0f);
+    range.table_max = V::set1(lut ? static_cast<float>(lut->table.size() - 2) : 0.0f);
+
+    for (int i = 0; i < factor; ++i)
+        std::fill(band + static_cast<ptrdiff_t>(i) * row_stride + src_w, band + static_cast<ptrdiff_t>(i + 1) * row_stride, 0.0f);
+    std::fill(avg_row + src_w, avg_row + row_stride, 0.0f);
+
+    for (int outer_y = y_begin; outer_y < y_end; ++outer_y) {
+        const int syr = outer_y * factor;
+        const int rows = std::min(factor, src_h - syr);
+
+        for (int i = 0; i < rows; ++i)
+            convertRow<V>(srcp + static_cast<ptrdiff_t>(syr + i) * src_stride, band + static_cast<ptrdiff_t>(i) * row_stride, src_w);
+
+        for (int x = 0; x < src_w; x += W) {
+            f sum = V::zero();
+            for (int i = 0; i < rows; ++i)
+                sum = V::add(sum, V::load(band + static_cast<ptrdiff_t>(i) * row_stride + x));
+            V::store(sum_pixel + x, sum);
+        }
+
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+            const int sxr = outer_x * factor;
+            const int exr = std::min(sxr + factor, src_w);
+
+            float sum = 0.0f;
+            for (int x = sxr; x < exr; ++x)
+                sum += sum_pixel[x];
+
+            std::fill(avg_row + sxr, avg_row + exr, sum / static_cast<float>(rows * (exr - sxr)));
+        }
+
+        for (int x = 0; x < src_w; x += W) {
+            const f avg = V::load(avg_row + x);
+            f pixel_sum = V::zero();
+            f weight_sum = V::zero();
+
+            for (int i = 0; i < rows; ++i) {
+                const f pixel = V::load(band + static_cast<ptrdiff_t>(i) * row_stride + x);
+                const f weight = rangeKernel<V, Lambda>(avg, pixel, range);
+
+                pixel_sum = V::add(pixel_sum, V::mul(weight, pixel));
+                weight_sum = V::add(weight_sum, weight);
+            }
+
+            V::store(sum_pixel + x, pixel_sum);
+            V::store(sum_weight + x, weight_sum);
+        }
+
+        float * dst = dstp + static_cast<ptrdiff_t>(outer_y) * dst_stride;
+
+        for (int outer_x = 0; outer_x < dst_w; ++outer_x) {
+            const int sxr = outer_x * factor;
+            const int exr = std::min(sxr + factor, src_w);
+
+            float pixel_sum = 0.0f;
+            float weight_sum = 0.0f;
+            for (int x = sxr; x < exr; ++x) {
+                pixel_sum += sum_pixel[x];
+                weight_sum += sum_weight[x];
+            }
+
+            dst[outer_x] = (weight_sum == 0.0f) ? avg_row[sxr] : pixel_sum / weight_sum;
+        }
+    }
+}
+
+static inline DpidResize getResize(int bytes_per_sample, bool is_float) noexcept {
+    if (!is_float && bytes_per_sample == 1)
+        return dpid_resize::getResize<uint8_t>();
+    else if (!is_float && bytes_per_sample == 2)
+        return dpid_resize::getResize<uint16_t>();
+    else if (is_float && bytes_per_sample == 2)
+        return dpid_resize::getResize<DpidHalf>();
+    else if (is_float && bytes_per_sample == 4)
+        return dpid_resize::getResize<float>();
+
+    return nullptr;
+}
+
+static inline DpidBlur getBlur(int bytes_per_sample, bool is_float) noexcept {
+    if (!is_float && bytes_per_sample == 1)
+        return dpid_blur::getBlur<uint8_t>();
+    else if (!is_float && bytes_per_sample == 2)
+        return dpid_blur::getBlur<uint16_t>();
+    else if (is_float && bytes_per_sample == 2)
+        return dpid_blur::getBlur<DpidHalf>();
+    else if (is_float && bytes_per_sample == 4)
+        return dpid_blur::getBlur<float>();
+
+    return nullptr;
+}
+
+template<typename V, typename T, int Lambda>
+static DpidKernel getKernel(bool aligned) noexcept {
+    return aligned ? dpidProcess<V, T, Lambda, true> : dpidProcess<V, T, Lambda, false>;
+}
+
+template<typename V, typename T>
+static DpidKernel getKernel(int lambda_class, bool aligned) noexcept {
+    switch (lambda_class) {
+    case DPID_LAMBDA_0:
+        return getKernel<V, T, DPID_LAMBDA_0>(aligned);
+    case DPID_LAMBDA_0_5:
+        return getKernel<V, T, DPID_LAMBDA_0_5>(aligned);
+    case DPID_LAMBDA_1:
+        return getKernel<V, T, DPID_LAMBDA_1>(aligned);
+    case DPID_LAMBDA_2:
+        return getKernel<V, T, DPID_LAMBDA_2>(aligned);
+    case DPID_LAMBDA_LUT:
+        if constexpr (std::is_integral_v<T>)
+            return getKernel<V, T, DPID_LAMBDA_LUT>(aligned);
+        return nullptr;
+    case DPID_LAMBDA_LUT_LERP:
+        if constexpr (std::is_integral_v<T>)
+            return getKernel<V, T, DPID_LAMBDA_LUT_LERP>(aligned);
+        return nullptr;
+    case DPID_LAMBDA_FAST:
+        return getKernel<V, T, DPID_LAMBDA_FAST>(aligned);
+    default:
+        return getKernel<V, T, DPID_LAMBDA_ANY>(aligned);
+    }
+}
+
+template<typename V>
+static DpidKernel getKernel(int bytes_per_sample, bool is_float, int lambda_class, bool aligned) noexcept {
+    if (!is_float && bytes_per_sample == 1)
+        return getKernel<V, uint8_t>(lambda_class, aligned);
+    else if (!is_float && bytes_per_sample == 2)
+        return getKernel<V, uint16_t>(lambda_class, aligned);
+    else if (is_float && bytes_per_sample == 2)
+        return getKernel<V, DpidHalf>(lambda_class, aligned);
+    else if (is_float && bytes_per_sample == 4)
+        return getKernel<V, float>(lambda_class, aligned);
+
+    return nullptr;
+}
+
+template<typename V, typename T>
+static DpidKernel getHistogramKernel(int lambda_class, bool aligned) noexcept {
+    switch (lambda_class) {
+    case DPID_LAMBDA_ANY:
+        return aligned ? dpidProcessHistogram<V, T, DPID_LAMBDA_ANY, true> : dpidProcessHistogram<V, T, DPID_LAMBDA_ANY, false>;
+    case DPID_LAMBDA_FAST:
+        return aligned ? dpidProcessHistogram<V, T, DPID_LAMBDA_FAST, true> : dpidProcessHistogram<V, T, DPID_LAMBDA_FAST, false>;
+    default:
+        return nullptr;
+    }
+}
+
+template<typename V>
+static DpidKernel getHistogramKernel(int bytes_per_sample, int lambda_class, bool aligned) noexcept {
+    if (bytes_per_sample == 1)
+        return getHistogramKernel<V, uint8_t>(lambda_class, aligned);
+    else if (bytes_per_sample == 2)
+        return getHistogramKernel<V, uint16_t>(lambda_class, aligned);
+
+    return nullptr;
+}
+
+template<typename V, typename T>
+static DpidWeights getWeights(int lambda_class) noexcept {
+    switch (lambda_class) {
+    case DPID_LAMBDA_0:
+        return dpidWeights<V, T, DPID_LAMBDA_0>;
+    case DPID_LAMBDA_0_5:
+        return dpidWeights<V, T, DPID_LAMBDA_0_5>;
+    case DPID_LAMBDA_1:
+        return dpidWeights<V, T, DPID_LAMBDA_1>;
+    case DPID_LAMBDA_2:
+        return dpidWeights<V, T, DPID_LAMBDA_2>;
+    case DPID_LAMBDA_LUT:
+        if constexpr (std::is_integral_v<T>)
+            return dpidWeights<V, T, DPID_LAMBDA_LUT>;
+        return nullptr;
+    case DPID_LAMBDA_LUT_LERP:
+        if constexpr (std::is_integral_v<T>)
+            return dpidWeights<V, T, DPID_LAMBDA_LUT_LERP>;
+        return nullptr;
+    case DPID_LAMBDA_FAST:
+        return dpidWeights<V, T, DPID_LAMBDA_FAST>;
+    default:
+        return dpidWeights<V, T, DPID_LAMBDA_ANY>;
+    }
+}
+
+template<typename V>
+static DpidWeights getWeights(int bytes_per_sample, bool is_float, int lambda_class) noexcept {
+    if (!is_float && bytes_per_sample == 1)
+        return getWeights<V, uint8_t>(lambda_class);
+    else if (!is_float && bytes_per_sample == 2)
+        return getWeights<V, uint16_t>(lambda_class);
+    else if (is_float && bytes_per_sample == 2)
+        return getWeights<V, DpidHalf>(lambda_class);
+    else if (is_float && bytes_per_sample == 4)
+        return getWeights<V, float>(lambda_class);
+
+    return nullptr;
+}
+
+template<typename V>
+static DpidSharedKernel getSharedKernel(int bytes_per_sample, bool is_float, bool aligned) noexcept {
+    if (!is_float && bytes_per_sample == 1)
+        return aligned ? dpidProcessShared<V, uint8_t, true> : dpidProcessShared<V, uint8_t, false>;
+    else if (!is_float && bytes_per_sample == 2)
+        return aligned ? dpidProcessShared<V, uint16_t, true> : dpidProcessShared<V, uint16_t, false>;
+    else if (is_float && bytes_per_sample == 2)
+        return aligned ? dpidProcessShared<V, DpidHalf, true> : dpidProcessShared<V, DpidHalf, false>;
+    else if (is_float && bytes_per_sample == 4)
+        return aligned ? dpidProcessShared<V, float, true> : dpidProcessShared<V, float, false>;
+
+    return nullptr;
+}
+
+template<typename V, typename T>
+static DpidSweepKernel getSweepKernel(bool fast, bool aligned) noexcept {
+    if (fast)
+        return aligned ? dpidProcessSweep<V, T, true, true> : dpidProcessSweep<V, T, false, true>;
+
+    return aligned ? dpidProcessSweep<V, T, true, false> : dpidProcessSweep<V, T, false, false>;
+}
+
+template<typename V>
+static DpidSweepKernel getSweepKernel(int bytes_per_sample, bool is_float, bool fast, bool aligned) noexcept {
+    if (!is_float && bytes_per_sample == 1)
+        return getSweepKernel<V, uint8_t>(fast, aligned);
+    else if (!is_float && bytes_per_sample == 2)
+        return getSweepKernel<V, uint16_t>(fast, aligned);
+    else if (is_float && bytes_per_sample == 2)
+        return getSweepKernel<V, DpidHalf>(fast, aligned);
+    else if (is_float && bytes_per_sample == 4)
+        return getSweepKernel<V, float>(fast, aligned);
+
+    return nullptr;
+}
+
+template<typename V, typename T>
+static DpidReduce getReduce(int lambda_class) noexcept {
+    switch (lambda_class) {
+    case DPID_LAMBDA_0:
+        return dpidReduce<V, T, DPID_LAMBDA_0>;
+    case DPID_LAMBDA_0_5:
+        return dpidReduce<V, T, DPID_LAMBDA_0_5>;
+    case DPID_LAMBDA_1:
+        return dpidReduce<V, T, DPID_LAMBDA_1>;
+    case DPID_LAMBDA_2:
+        return dpidReduce<V, T, DPID_LAMBDA_2>;
+    case DPID_LAMBDA_LUT:
+        if constexpr (std::is_integral_v<T>)
+            return dpidReduce<V, T, DPID_LAMBDA_LUT>;
+        return nullptr;
+    case DPID_LAMBDA_LUT_LERP:
+        if constexpr (std::is_integral_v<T>)
+            return dpidReduce<V, T, DPID_LAMBDA_LUT_LERP>;
+        return nullptr;
+    case DPID_LAMBDA_FAST:
+        return dpidReduce<V, T, DPID_LAMBDA_FAST>;
+    default:
+        return dpidReduce<V, T, DPID_LAMBDA_ANY>;
+    }
+}
+
+template<typename V>
+static DpidReduce getReduce(int bytes_per_sample, bool is_float, int lambda_class) noexcept {
+    if (!is_float && bytes_per_sample == 1)
+        return getReduce<V, uint8_t>(lambda_class);
+    else if (!is_float && bytes_per_sample == 2)
+        return getReduce<V, uint16_t>(lambda_class);
+    else if (is_float && bytes_per_sample == 2)
+        return getReduce<V, DpidHalf>(lambda_class);
+    else if (is_float && bytes_per_sample == 4)
+        return getReduce<V, float>(lambda_class);
+
+    return nullptr;
+}
+
+} // namespace dpid_simd
+
+#endif // DPID_SIMD_H
@@ -0,0 +1,102 @@
+#include <smmintrin.h>
+
+#include "dpid_simd.h"
+
+
+namespace {
+
+struct VecSSE41 {
+    static constexpr int width = 4;
+
+    using f = __m128;
+    using i = __m128i;
+    using m = __m128;
+
+    static f zero() { return _mm_setzero_ps(); }
+    static f set1(float x) { return _mm_set1_ps(x); }
+    static f load(const float * p) { return _mm_load_ps(p); }
+    static f loadu(const float * p) { return _mm_loadu_ps(p); }
+    static void store(float * p, f x) { _mm_store_ps(p, x); }
+    static void storeu(float * p, f x) { _mm_storeu_ps(p, x); }
+
+    // no F16C below AVX2
+    static f loadh(const uint16_t * p) {
+        return _mm_setr_ps(dpidHalfToFloat(p[0]), dpidHalfToFloat(p[1]), dpidHalfToFloat(p[2]), dpidHalfToFloat(p[3]));
+    }
+    static void storeh(uint16_t * p, f x) {
+        alignas(16) float t[4];
+        _mm_store_ps(t, x);
+        for (int j = 0; j < 4; ++j)
+            p[j] = dpidFloatToHalf(t[j]);
+    }
+
+    static f add(f a, f b) { return _mm_add_ps(a, b); }
+    static f sub(f a, f b) { return _mm_sub_ps(a, b); }
+    static f mul(f a, f b) { return _mm_mul_ps(a, b); }
+    static f div(f a, f b) { return _mm_div_ps(a, b); }
+    static f min(f a, f b) { return _mm_min_ps(a, b); }
+    static f max(f a, f b) { return _mm_max_ps(a, b); }
+    static f abs(f a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static f sqrt(f a) { return _mm_sqrt_ps(a); }
+    static f floor(f a) { return _mm_floor_ps(a); }
+    static f ceil(f a) { return _mm_ceil_ps(a); }
+
+    static m lt(f a, f b) { return _mm_cmplt_ps(a, b); }
+    static m gt(f a, f b) { return _mm_cmpgt_ps(a, b); }
+    static m eq(f a, f b) { return _mm_cmpeq_ps(a, b); }
+    static f select(m mask, f a, f b) { return _mm_blendv_ps(b, a, mask); }
+
+    static i cvtt(f a) { return _mm_cvttps_epi32(a); }
+    static f cvt(i a) { return _mm_cvtepi32_ps(a); }
+    static i castfi(f a) { return _mm_castps_si128(a); }
+    static f castif(i a) { return _mm_castsi128_ps(a); }
+    static i iloadu(const int * p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+    static i iset1(int x) { return _mm_set1_epi32(x); }
+    static i iadd(i a, i b) { return _mm_add_epi32(a, b); }
+    static i isub(i a, i b) { return _mm_sub_epi32(a, b); }
+    static i iand(i a, i b) { return _mm_and_si128(a, b); }
+    static i ior(i a, i b) { return _mm_or_si128(a, b); }
+    static i isrl23(i a) { return _mm_srli_epi32(a, 23); }
+    static i isll23(i a) { return _mm_slli_epi32(a, 23); }
+
+    static f gather(const float * p, i idx) {
+        alignas(16) int32_t j[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(j), idx);
+        return _mm_setr_ps(p[j[0]], p[j[1]], p[j[2]], p[j[3]]);
+    }
+};
+
+} // namespace
+
+
+DpidResize dpidGetResizeSSE41(int bytes_per_sample, bool is_float) noexcept {
+    return dpid_simd::getResize(bytes_per_sample, is_float);
+}
+
+DpidBlur dpidGetBlurSSE41(int bytes_per_sample, bool is_float) noexcept {
+    return dpid_simd::getBlur(bytes_per_sample, is_float);
+}
+
+DpidKernel dpidGetKernelSSE41(int bytes_per_sample, bool is_float, int lambda_class, bool aligned) noexcept {
+    return dpid_simd::getKernel<VecSSE41>(bytes_per_sample, is_float, lambda_class, aligned);
+}
+
+DpidSweepKernel dpidGetSweepKernelSSE41(int bytes_per_sample, bool is_float, bool fast, bool aligned) noexcept {
+    return dpid_simd::getSweepKernel<VecSSE41>(bytes_per_sample, is_float, fast, aligned);
+}
+
+DpidKernel dpidGetHistogramKernelSSE41(int bytes_per_sample, int lambda_class, bool aligned) noexcept {
+    return dpid_simd::getHistogramKernel<VecSSE41>(bytes_per_sample, lambda_class, aligned);
+}
+
+DpidWeights dpidGetWeightsSSE41(int bytes_per_sample, bool is_float, int lambda_class) noexcept {
+    return dpid_simd::getWeights<VecSSE41>(bytes_per_sample, is_float, lambda_class);
+}
+
+DpidSharedKernel dpidGetSharedKernelSSE41(int bytes_per_sample, bool is_float, bool aligned) noexcept {
+    return dpid_simd::getSharedKernel<VecSSE41>(bytes_per_sample, is_float, aligned);
+}
+
+DpidReduce dpidGetReduceSSE41(int bytes_per_sample, bool is_float, int lambda_class) noexcept {
+    return dpid_simd::getReduce<VecSSE41>(bytes_per_sample, is_float, lambda_class);
+}
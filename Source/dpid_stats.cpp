@@ -0,0 +1,36 @@
+#include "dpid_stats.h"
+#include <algorithm>
+#include <mutex>
+
+
+static std::mutex registry_mutex;
+static std::vector<std::shared_ptr<DpidCounters>> registry;
+
+std::shared_ptr<DpidCounters> dpidAddCounters() {
+    auto counters = std::make_shared<DpidCounters>();
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(counters);
+    return counters;
+}
+
+std::vector<std::shared_ptr<DpidCounters>> dpidGetCounters() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return registry;
+}
+
+void dpidResetCounters() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    // the registry holds the last reference of freed filters
+    registry.erase(std::remove_if(registry.begin(), registry.end(),
+        [](const std::shared_ptr<DpidCounters> &counters) { return counters.use_count() == 1; }), registry.end());
+
+    for (auto &counters : registry) {
+        counters->frames = 0;
+        counters->guide_ns = 0;
+        counters->kernel_ns = 0;
+        counters->pixels = 0;
+        counters->footprint = 0;
+    }
+}
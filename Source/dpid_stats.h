@@ -0,0 +1,38 @@
+#ifndef DPID_STATS_H
+#define DPID_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Performance counters of one plane of a filter, filled with stats=True and
+// read by dpid.Stats(). Planes whose kernel depends on the frame, like chroma
+// planes with read_chromaloc, get one set per variant.
+struct DpidCounters {
+    std::string filter;    // function name
+    int plane;
+    int width, height;     // output size of the plane
+    std::string variant;   // sample type, instruction set and kernel
+    int64_t footprint_row; // source pixels read for one output row, summed over the row
+
+    std::atomic<int64_t> frames {0};
+    std::atomic<int64_t> guide_ns {0};  // resize and blur, summed over threads
+    std::atomic<int64_t> kernel_ns {0}; // summed over threads
+    std::atomic<int64_t> pixels {0};    // output pixels
+    std::atomic<int64_t> footprint {0}; // source pixels read by the kernel
+};
+
+// Adds counters to the list reported by dpid.Stats(). They stay listed after
+// their filter is freed, until the next reset.
+std::shared_ptr<DpidCounters> dpidAddCounters();
+
+// all listed counters, in the order they were added
+std::vector<std::shared_ptr<DpidCounters>> dpidGetCounters();
+
+// zeroes the counters and drops the ones of freed filters
+void dpidResetCounters();
+
+#endif // DPID_STATS_H